@@ -12,14 +12,36 @@ World : Represents the entire simulation world.
 
 #pragma once
 
+#include <cmath>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <queue>
 #include <vector>
 #include <string>
 #include <map>
 
+#define MAX_INTEGER_EXPONENT 16 // Acceleration exponents up to this one are computed by repeated squaring
+
 typedef std::queue<int> Path;
 
+struct SPT;
+
+/*
+ * Remaining path of an actor, the intersections it still has to visit up to its destination. Actors routed with a
+ * shortest path tree only keep the next intersection and look up the one after it in the tree when they enter the
+ * street to it (see pathFront and pathPop in routing.hpp), so the path takes constant memory. Paths from other routers
+ * (contraction hierarchies) are stored in queued.
+ */
+typedef struct ActorPath {
+    const struct SPT* tree = nullptr;
+    int next = -1; // Next intersection, -1 if the path is empty
+    int end = -1; // Destination
+    std::unique_ptr<Path> queued;
+} actorPath_t;
+
 enum ActorTypes {
     Bike,
     Car
@@ -43,12 +65,13 @@ typedef struct Actor {
     float acceleration = 4*0.73f; // m/s^2
     float deceleration = 2*1.67f; // m/s^2
     float acceleration_exp = 10.0f; // unitless
+    int integer_exp = 10; // acceleration_exp if it is a small integer, otherwise -1, see setAccelerationExponent
 
     float insertAfter = 0.0f; // After how many seconds the actor should try to be inserted at the intersection
 
     // Only used for visualization
-    std::string id = "empty";
-    Path path;
+    int id = -1; // Index of the id of the agent in World::agentIds
+    actorPath_t path;
     bool outputFlag = false; // this flag is needed for exporter to know if non-active actors status has been outputted once
 
     float start_time = -1.0f;
@@ -65,12 +88,33 @@ typedef struct Actor {
     float distanceToFront = 0;
 } actor_t;
 
+/*
+ * Sets the acceleration exponent of an actor and selects the kernel which computes the power for it (see
+ * idmAcceleration in update.hpp). Defined here so the tools which import agents don't need the street update.
+ */
+inline void setAccelerationExponent(Actor* actor, const float exponent)
+{
+    actor->acceleration_exp = exponent;
+    const bool integer = exponent >= 1.0f && exponent <= MAX_INTEGER_EXPONENT && exponent == std::floor(exponent);
+    actor->integer_exp = integer ? static_cast<int>(exponent) : -1;
+}
+
 enum StreetTypes {
     OnlyBike,
     OnlyCar,
     Both
 };
 
+/*
+ * One lane of a street while its traffic is updated. queue holds the actors of the lane which the update has not reached
+ * yet, in the order of traffic, and leader the last actor of the lane it has already passed. The vehicles in front of an
+ * actor and behind it on its own and the neighbouring lanes are the leaders and queue fronts of these lanes.
+ */
+typedef struct Lane {
+    std::deque<Actor*> queue;
+    Actor* leader = nullptr;
+} lane_t;
+
 typedef struct Street {
     int start = -1;
     int end = -1;
@@ -80,11 +124,16 @@ typedef struct Street {
     StreetTypes type = StreetTypes::Both;
     size_t width = 2;
     float length = 100.0f;
-    float speedlimit = 50.0f; // km/h
+    float speedlimit = 50.0f; // m/s, importMap converts the km/h of the map
 
     // Ordered by distance to end, must be reordered when actors change position
     // Furthermore, when vehicles swap position, their position to the left of the road side must be swapped as well
     std::vector<Actor*> traffic;
+    // Traffic split by lane (distanceToRight / LANE_WIDTH), only valid while the street is updated
+    std::vector<Lane> lanes;
+    // Actors handed over by the start intersection in updateData, appended to traffic once all intersections committed
+    std::vector<Actor*> incoming;
+    bool active = false; // Listed in World::activeStreets
 
     // These values are not used by the simulation itself, just for the visualization later
     // start and end position
@@ -107,22 +156,49 @@ typedef struct Intersection {
     float currentPhase = 5.0f;
     int32_t green = 0;
 
-    std::vector<Actor*> waitingToBeInserted;
+    std::deque<Actor*> waitingToBeInserted; // Only the first one may depart, once its insertAfter has passed
     std::vector<std::pair<Actor*, Street*>> arrivedFrom;
     bool outputFlag = true; // All intersections which have this set are added to the output.
     bool hasTrafficLight = false;
     float car_flow_accumulate = 0.0f;
     float bike_flow_accumulate = 0.0f;
     bool needsUpdate = false;
+    bool active = false; // Listed in World::activeIntersections
+    std::vector<Street*> entered; // Outbound streets actors entered in this step, see refreshActiveSets
+    bool ready = false; // The first waiting actor may depart
+    int departed = 0; // Actors which departed from the intersection in this step, see refreshActiveSets
+    int arrived = 0; // Actors which arrived at the intersection in this step, see refreshActiveSets
+    float departure = std::numeric_limits<float>::infinity(); // Departure the intersection is in World::departures for
 } intersection_t;
 
+/*
+ * Strings stored back to back in one buffer, the i-th string is chars[offsets[i], offsets[i + 1]). Used for the ids of the
+ * agents, which are only needed for the output, so every actor keeps an index instead of a string of its own.
+ */
+typedef struct StringTable {
+    std::string chars;
+    std::vector<std::size_t> offsets = {0};
+} stringTable_t;
+
 typedef struct World {
     std::vector<Intersection> intersections;
     std::vector<Street> streets;
     std::vector<Actor*> actors;
+    std::vector<Actor> actorArena; // Storage of all actors, actors[i] points to actorArena[i], see allocateActors
+    StringTable agentIds;
     std::map<std::string, int> string_to_int;
     std::map<int, std::string> int_to_string;
     std::vector<Intersection*> IntersectionPtr;
     std::vector<Street*> StreetPtr;
+    // Streets with traffic and the intersections which can change something in a step, the only ones which are updated
+    std::vector<Street*> activeStreets;
+    std::vector<Intersection*> activeIntersections;
+    bool activeSetsValid = false; // Set to false after changing traffic outside of update.hpp, see buildActiveSets
+    // Departure time of the first waiting actor and index of every intersection which isn't ready yet, earliest first
+    std::priority_queue<std::pair<float, int>, std::vector<std::pair<float, int>>, std::greater<>> departures;
+    // Actors which haven't departed yet, are on a street or have arrived, see buildActiveSets
+    std::size_t waitingActors = 0;
+    std::size_t drivingActors = 0;
+    std::size_t arrivedActors = 0;
     Street empty;
 } world_t;
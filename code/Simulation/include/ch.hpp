@@ -0,0 +1,96 @@
+/*
+Contraction hierarchies, an alternative to the shortest path tree for large maps.
+
+The intersections are contracted one by one in the order of their importance. When an intersection is contracted,
+shortcuts are added between its neighbours wherever it lies on the only shortest path between them. A query then
+only needs to run a bidirectional Dijkstra which goes upwards in the hierarchy from both ends, which only touches a
+few hundred intersections, even on large maps. Memory is linear in the number of streets and shortcuts.
+*/
+
+#pragma once
+
+#include <vector>
+#include "actors.hpp"
+
+#define CH_FILE_MAGIC "CSSMCH02" // First 8 bytes of a file containing a contraction hierarchy
+#define CH_WITNESS_SETTLE_LIMIT 500 // Maximum number of intersections a witness search settles before giving up
+
+// Edge of the upward graph. Shortcuts have the contracted intersection they skip as middle, streets have -1.
+typedef struct CHEdge {
+    int target;
+    int middle;
+    double weight;
+} chEdge_t;
+
+typedef struct ContractionHierarchy {
+    int size = 0;
+    std::vector<int> rank; // Position of the intersection in the contraction order
+    // forward[forwardOffset[u]..forwardOffset[u + 1]) are the edges u -> target with rank[target] > rank[u]
+    std::vector<int> forwardOffset;
+    std::vector<chEdge_t> forward;
+    // backward[backwardOffset[v]..backwardOffset[v + 1]) are the edges target -> v with rank[target] > rank[v]
+    std::vector<int> backwardOffset;
+    std::vector<chEdge_t> backward;
+} ch_t;
+
+/**
+Builds the contraction hierarchy of the given world.
+
+@param world The world to build the hierarchy for.
+@param include The types of streets to include, i.e. {Both, OnlyCar} for cars and {Both, OnlyBike} for bikes.
+
+@return The contraction hierarchy.
+*/
+ch_t buildContractionHierarchy(const world_t* world, const std::vector<StreetTypes>& include);
+
+/**
+Retrieves the path from start to end with a query on the contraction hierarchy.
+
+@param ch The contraction hierarchy.
+@param start The start of the path.
+@param end The end of the path.
+
+@return The path from start to end, excluding start. Empty if there is no path.
+*/
+Path retrievePath(const ch_t* ch, const int &start, const int &end);
+
+/**
+Retrieves the paths of many agents at once, the queries are answered in parallel.
+
+@param ch The contraction hierarchy.
+@param queries The start and end of every path.
+
+@return The paths in the order of the queries.
+*/
+std::vector<Path> retrievePaths(const ch_t* ch, const std::vector<std::pair<int, int>>& queries);
+
+/**
+Writes the contraction hierarchy to a binary file, together with the mapFingerprint of the world.
+
+@param ch The contraction hierarchy.
+@param file_name The name of the output file.
+@param world The world the hierarchy was built for.
+
+@return True if the operation was successful, false otherwise.
+*/
+bool saveContractionHierarchy(const ch_t* ch, const char* file_name, const world_t* world);
+
+/**
+Loads a contraction hierarchy from a binary file. Fails if it was built for a map with another mapFingerprint.
+
+@param ch The contraction hierarchy to load into.
+@param file_name The name of the input file.
+@param world The world the hierarchy was built for.
+
+@return True if the operation was successful, false otherwise.
+*/
+bool loadContractionHierarchy(ch_t* ch, const char* file_name, const world_t* world);
+
+/**
+Checks if a file contains a contraction hierarchy instead of a shortest path tree.
+
+@param file_name The name of the file.
+
+@return True <=> the file starts with CH_FILE_MAGIC.
+*/
+bool isContractionHierarchyFile(const char* file_name);
@@ -0,0 +1,62 @@
+#ifndef CSSMALG_CPUFW_H
+#define CSSMALG_CPUFW_H
+
+#include <cstddef>
+
+#define FW_BLOCK_SIZE 64 // Edge length of a tile, three tiles of distances and neighbours fit into the L2 cache
+#define FW_SCRATCH_MAGIC "CSSMFWOC" // First 8 bytes of the scratch file of FloydWarshalOutOfCore
+
+/**
+Compute floyd Warshall algorithm on a graph on the cpu with the textbook i/j/k triple loop. Single threaded, only kept
+as a reference for the other implementations.
+
+@param dis, pointer to a Array of size V*V, where V is the number of vertices in the graph, containing the distance between points.
+@param next, pointer to a Array of size V*V, where V is the number of vertices in the graph, containing the next vertex in the shortest path.
+@param V, number of vertices in the graph
+*/
+void FloydWarshalNaive(double* dis, int* next, int V);
+
+/**
+Compute floyd Warshall algorithm on a graph on the cpu. The matrix is split into FW_BLOCK_SIZE x FW_BLOCK_SIZE tiles
+which are processed in the three phases of the blocked algorithm (diagonal tile, row and column tiles, remaining tiles).
+The tiles of the second and third phase are independent and processed in parallel with OpenMP.
+
+@param dis, pointer to a Array of size V*V, where V is the number of vertices in the graph, containing the distance between points.
+@param next, pointer to a Array of size V*V, where V is the number of vertices in the graph, containing the next vertex in the shortest path.
+@param V, number of vertices in the graph
+*/
+void FloydWarshalBlocked(double* dis, int* next, int V);
+
+/**
+Compute floyd Warshall algorithm on two graphs with the same vertices at once on the cpu, e.g. the car and the bike
+graph. The rows of both graphs are interleaved, so every tile of FloydWarshalBlocked holds both graphs and the
+matrices are only streamed through the cache once. The tiles have the same FW_BLOCK_SIZE edge length, so they hold twice
+the data of a tile of FloydWarshalBlocked.
+
+@param dis, pointer to a Array of size 2*V*V, the distance from i to j in graph l is at (2 * i + l) * V + j.
+@param next, pointer to a Array of size 2*V*V, the next vertex in the shortest path, same layout as dis.
+@param V, number of vertices in the graphs
+*/
+void FloydWarshalBlockedPair(double* dis, int* next, int V);
+
+/**
+Compute floyd Warshall algorithm on a graph whose distance and next matrices don't fit into memory. The tiles of
+FloydWarshalBlocked are kept in a memory mapped scratch file and only the tiles of the current k-block row and column
+are held in memory, the other tiles are streamed through it. After every k-block the scratch file is synced to disk, so
+if the run is killed, calling the function again with the same scratch file and graph resumes after the last finished
+k-block. The scratch file is left in place, it can be deleted once the next vertices have been saved.
+
+@param scratch, name of the scratch file, it needs about 12 * V * V bytes of disk.
+@param V, number of vertices in the graph
+@param from, start vertex of every edge
+@param to, end vertex of every edge
+@param weight, weight of every edge
+@param E, number of edges
+@param next, pointer to a Array of size V*V which receives the next vertex in the shortest path, e.g. a memory mapped file.
+@param transposed, store the next vertex from i to j at j * V + i instead of i * V + j.
+
+@return True if successful, false if the scratch file couldn't be created.
+*/
+bool FloydWarshalOutOfCore(const char* scratch, int V, const int* from, const int* to, const double* weight, std::size_t E, int* next, bool transposed);
+
+#endif //CSSMALG_CPUFW_H
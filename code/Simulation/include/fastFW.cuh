@@ -14,4 +14,13 @@ Compute floyd Warshall algorithm on a graph
 */
 void FloydWarshal(double* dis, int* next, int V);
 
+/**
+Compute floyd Warshall algorithm on two graphs with the same vertices at once, e.g. the car and the bike graph.
+
+@param dis, pointer to a Array of size 2*V*V, the distance from i to j in graph l is at (2 * i + l) * V + j.
+@param next, pointer to a Array of size 2*V*V, the next vertex in the shortest path, same layout as dis.
+@param V, number of vertices in the graphs
+*/
+void FloydWarshalPair(double* dis, int* next, int V);
+
 #endif //CSSMALG_FASTFW_H
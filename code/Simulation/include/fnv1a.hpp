@@ -0,0 +1,24 @@
+#ifndef CSSMALG_FNV1A_H
+#define CSSMALG_FNV1A_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define FNV1A_OFFSET_BASIS 14695981039346656037ull // Initial value of a 64 bit FNV-1a hash
+
+/**
+Adds bytes to a 64 bit FNV-1a hash, used for the fingerprints of maps and graphs in the files of the simulation.
+
+@param hash, hash to update, starts at FNV1A_OFFSET_BASIS
+@param data, pointer to the bytes to add
+@param bytes, number of bytes to add
+*/
+inline void fnv1a(uint64_t& hash, const void* data, const std::size_t bytes)
+{
+    const unsigned char* byte = static_cast<const unsigned char*>(data);
+    for (std::size_t b = 0; b < bytes; b++) {
+        hash = (hash ^ byte[b]) * 1099511628211ull;
+    }
+}
+
+#endif //CSSMALG_FNV1A_H
@@ -1,13 +1,39 @@
 #pragma once
 
 #include <fstream>
+#include <cstdint>
 #include <nlohmann/json.hpp>
 
 #include "actors.hpp"
 #include "routing.hpp"
+#include "ch.hpp"
 
 using nlohmann::json;
 
+#define SPT_FILE_MAGIC "CSSMSPT1" // First 8 bytes of a binary shortest path tree, files without it are base64 encoded
+#define SPT_FILE_VERSION 2
+#define SPT_FILE_DESTINATION_MAJOR 1 // Flag of a tree stored destination-major, see spt_t::destinationMajor
+#define SPT_FILE_CHAINS 2 // Flag of a tree with contracted chains, the tree and the float distances of the reduced graph follow
+#define SPT_FILE_DISTANCES 4 // Flag of a full tree followed by its size * size float distances, aligned to 4 bytes
+
+// Header of a binary shortest path tree, followed by the size * size next hops as ints or, for neighbour slot encoded
+// trees, by neighbourOffset, neighbours and the rows of slots. It is 64 bytes long, so the data is aligned when the file
+// is memory mapped.
+typedef struct SPTFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t size;
+    uint32_t elementBits; // Bits per next hop, 32 for intersection ids, 4 or 8 for neighbour slots
+    uint32_t streetTypes; // Bit 1 << type is set for every included StreetTypes
+    uint64_t fingerprint; // mapFingerprint of the map the tree was computed for
+    uint64_t neighbourCount; // Length of the neighbour table, 0 for intersection ids
+    uint64_t flags; // SPT_FILE_DESTINATION_MAJOR, SPT_FILE_CHAINS, SPT_FILE_DISTANCES
+    uint64_t reducedSize; // Intersections of the reduced graph of a tree with SPT_FILE_CHAINS
+    uint64_t reserved[1];
+} sptFileHeader_t;
+
+static_assert(sizeof(sptFileHeader_t) == 64, "The header must keep the next hops aligned");
+
 /**
 Loads a file with json format into a json buffer
 
@@ -27,6 +53,18 @@ Small wrapper to determine if the map contains a precomputed SPT.
 */
 bool hasPrecompute(const json* map);
 
+/**
+Applies a map diff to a map. The diff is a json object with the optional arrays "removeRoads", the ids of the roads to
+remove, and "roads", roads in the format of the map which replace the road with the same id or are added. Roads can only
+connect intersections which are already in the map.
+
+@param map: the map loaded from the json file, changed in place.
+@param diff: the diff loaded from the json file.
+
+@returns bool, false if the diff removes an unknown road or connects an unknown intersection.
+*/
+bool applyMapDiff(json* map, const json* diff);
+
 /**
 Imports a json object into the c++ data structure.
 
@@ -50,6 +88,29 @@ Imports a json object into the c++ data structure.
  */
 void importAgents(world_t* world, json* agents, spt_t* carsSPT, spt_t* bikeSPT);
 
+/**
+Imports a json object into the c++ data structure, the paths are queried from contraction hierarchies.
+
+@param world: (world) of current simulation
+@param agents: the agents loaded from the json file
+@param carsCH contraction hierarchy for cars
+@param bikeCH contraction hierarchy for bikes
+
+@returns void
+ */
+void importAgents(world_t* world, json* agents, const ch_t* carsCH, const ch_t* bikeCH);
+
+/**
+Collects the destinations of the agents of one type, used to compute demand driven shortest path trees.
+
+@param world: (world) of current simulation, the map must already be imported
+@param agents: the agents loaded from the json file
+@param type: "bikes" or "cars"
+
+@returns the intersection ids of the destinations, may contain duplicates.
+ */
+std::vector<int> agentDestinations(const world_t* world, const json* agents, const std::string& type);
+
 /**
 Exports the world to json format. It is the static part of the simulation. The simulation is added step by step with
 addFrame.
@@ -58,10 +119,13 @@ addFrame.
 @param time: elapsed time
 @param timeDelta: increment steps takeing in simulation
 @param originMap: originally imported map
+@param carsSPT: shortest path tree of the cars, the travel distances are taken from it if it keeps its distances
+@param bikeSPT: shortest path tree of the bikes, the travel distances are taken from it if it keeps its distances
 
 @returns json marshalling.
  */
-json exportWorld(const world_t* world, const float& time, const float& timeDelta, const json* originMap);
+json exportWorld(const world_t* world, const float& time, const float& timeDelta, const json* originMap,
+                 const spt_t* carsSPT = nullptr, const spt_t* bikeSPT = nullptr);
 
 /**
 Adds a frame to the output json.
@@ -115,12 +179,24 @@ void importSPT(spt_t* carTree, spt_t* bikeTree, const json* input, world_t* worl
 
 /**
 
-Dumps the contents of a spt_t struct to a binary file.
+Hashes the ids, ends, types and weights of the intersections and streets of a map. A tree is only valid for a map
+with the same fingerprint.
+@param world A pointer to the world object.
+@return The 64 bit FNV-1a hash of the map.
+*/
+uint64_t mapFingerprint(const world_t* world);
+
+/**
+
+Dumps the contents of a full, neighbour slot encoded or contracted spt_t struct to a binary file with a sptFileHeader_t.
+The distances of the tree are dumped as well if it keeps them.
 @param Tree A pointer to the spt_t struct to be dumped.
 @param file_name The name of the output file.
+@param world A pointer to the world object the tree was computed for.
+@param include The types of streets the tree was computed for.
 @return True if the operation was successful, false otherwise.
 */
-bool binDumpSpt(spt_t* Tree, const char* file_name);
+bool binDumpSpt(spt_t* Tree, const char* file_name, const world_t* world, const std::vector<StreetTypes>& include);
 
 /**
 Dumps statistics to a json object.
@@ -133,13 +209,23 @@ void jsonDumpStats(const float& avgTime, json* output, world_t* world, const boo
 
 /**
 
-Loads a spt_t struct from a binary file.
+Loads a spt_t struct from a binary file. Files written by binDumpSpt are memory mapped, so the next hops are neither
+copied nor decoded. The chains of contracted trees are found again on the world. They are refused if the header doesn't match the world or the street types. Legacy base64 encoded
+files are still decoded, but can't be checked.
 @param SPT A pointer to the spt_t struct to be loaded.
 @param file_name The name of the input file.
 @param world A pointer to the world object.
+@param include The types of streets the tree must have been computed for.
 @return True if the operation was successful, false otherwise.
 */
-bool binLoadTree(spt_t* SPT, const char* file_name, const world_t* world);
+bool binLoadTree(spt_t* SPT, const char* file_name, const world_t* world, const std::vector<StreetTypes>& include);
+
+/**
+
+Releases the next hops of a tree, either by unmapping the file or by deleting the array.
+@param SPT A pointer to the spt_t struct to be released.
+*/
+void freeSPT(spt_t* SPT);
 
 /**
 
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <map>
+#include <vector>
+#include <cassert>
+#include <cstddef>
 #include "actors.hpp"
 #define USE_CUDA // Use Cuda for Floyd Warschall
 //#define ALTFW
@@ -9,20 +12,514 @@
 // Enabeling this option changes the weight of an edge from the length of a road to the length of a road divided by the speed limit and the width of the road.
 // d = length / (velocity * width)
 
+#define DEMAND_DRIVEN_TREE "demand" // Passed instead of a tree file, the trees are computed for the destinations of the agents only
+#define REROUTE_MIN_VELOCITY 0.5 // m/s, travel times of jammed streets are estimated with at least this velocity
+
+struct Chains;
+
 typedef struct SPT {
     int* array;
     int size;
+    // Demand driven trees only store the columns of the destinations which are used. column[end] is the index of the
+    // column of the destination end in array, -1 if it was not computed. nullptr if array is the full size * size matrix.
+    int* column = nullptr;
+    // Neighbour slot encoded trees have no array. Row u of slots holds slotBits (4 or 8) per destination, the index of
+    // the next hop in the neighbour table neighbours[neighbourOffset[u]..neighbourOffset[u + 1]). All bits set means
+    // that the destination is not reachable. Rows are padded to rowBytes.
+    unsigned char* slots = nullptr;
+    int slotBits = 0;
+    std::size_t rowBytes = 0;
+    int* neighbourOffset = nullptr;
+    int* neighbours = nullptr;
+    // Destination-major trees store the next hop from u to end at end * size + u (also for the slots), so walking a
+    // path reads a single contiguous row.
+    bool destinationMajor = false;
+    // Trees computed on the graph with contracted degree 2 chains have no array, size is still the number of
+    // intersections. The next hops are derived from the tree of the reduced graph in chains.
+    struct Chains* chains = nullptr;
+    // Optional companion with the length of every path in the weights of Floyd Warshall (the length of the streets
+    // unless ALTFW), same layout as array (or as the slots), 1e30 if the destination is not reachable. Trees with
+    // contracted chains have the distances of the reduced graph instead.
+    float* distance = nullptr;
+    // Set if array points into a memory mapped tree file, which has to be unmapped instead of deleted.
+    void* mapping = nullptr;
+    std::size_t mappingSize = 0;
 } spt_t;
 
+// Chains of intersections with degree 2, i.e. intersections whose streets only go to and come from one neighbour on
+// each side, either one way (a -> v -> b) or two way (a <-> v <-> b). Such a chain is collapsed into a single edge from
+// its start to its end intersection, the remaining intersections form the reduced graph.
+typedef struct Chains {
+    std::vector<int> reduced; // Index of the intersection in the reduced graph, -1 if it is inside a chain
+    std::vector<int> core; // Intersection of every index of the reduced graph
+
+    // Per intersection inside a chain
+    std::vector<int> chain; // Chain of the intersection, -1 if it is part of the reduced graph
+    std::vector<int> forwardNext; // Next intersection towards the end of the chain
+    std::vector<int> backwardNext; // Next intersection towards the start of the chain, -1 for one way chains
+    std::vector<double> fromStart; // Distance from the start of the chain
+    std::vector<double> toEnd; // Distance to the end of the chain
+    std::vector<double> fromEnd; // Distance from the end of the chain, 1e30 for one way chains
+    std::vector<double> toStart; // Distance to the start of the chain, 1e30 for one way chains
+
+    // Per chain
+    std::vector<int> start; // Intersection of the reduced graph before the first intersection of the chain
+    std::vector<int> end; // Intersection of the reduced graph after the last intersection of the chain
+    std::vector<int> first;
+    std::vector<int> last;
+    std::vector<bool> twoWay;
+
+    // Shortest path tree of the reduced graph, indexed with reduced indices. The next hops are intersections of the full
+    // graph, so a next hop inside a chain tells which chain the path takes.
+    spt_t tree = {.array = nullptr, .size = 0};
+    float* distance = nullptr; // Distances of the reduced graph, same layout as the tree
+} chains_t;
+
+// Change of the weight of the edge from start to end, i.e. of the shortest street between them. 1e30 if there is none.
+typedef struct EdgeChange {
+    int start;
+    int end;
+    double before;
+    double after;
+} edgeChange_t;
+
+// Compressed sparse row adjacency of the street graph.
+typedef struct CSR {
+    std::vector<int> offset; // The edges of vertex v are in [offset[v], offset[v + 1])
+    std::vector<int> target;
+    std::vector<double> weight;
+} csr_t;
+
+/**
+Returns the next intersection on the shortest path from u to end in a tree with contracted chains.
+
+@param chains The chains and the tree of the reduced graph.
+@param u The current intersection.
+@param end The destination.
+*/
+int contractedNextHop(const chains_t* chains, const int u, const int end);
+
+/**
+Returns the length of the shortest path from u to end in a tree with contracted chains, 1e30 if end is not reachable.
+
+@param chains The chains and the tree of the reduced graph.
+@param u The start of the path.
+@param end The destination.
+*/
+double contractedDistance(const chains_t* chains, const int u, const int end);
+
+/**
+Returns the next intersection on the shortest path from u to end, -1 if end is not reachable from u.
+
+@param spt The shortest path tree.
+@param u The current intersection.
+@param end The destination.
+*/
+inline int nextHop(const spt_t* spt, const int u, const int end)
+{
+    if (spt->chains != nullptr) {
+        return contractedNextHop(spt->chains, u, end);
+    }
+    if (spt->slots != nullptr) {
+        if (u == end) {
+            return u;
+        }
+        const std::size_t row = spt->destinationMajor ? end : u;
+        const int entry = spt->destinationMajor ? u : end;
+        const unsigned char byte = spt->slots[row * spt->rowBytes + ((static_cast<std::size_t>(entry) * spt->slotBits) >> 3)];
+        const int slot = (spt->slotBits == 8) ? byte : (byte >> ((entry & 1) << 2)) & 0xF;
+        return (slot == (1 << spt->slotBits) - 1) ? -1 : spt->neighbours[spt->neighbourOffset[u] + slot];
+    }
+    if (spt->destinationMajor) {
+        return spt->array[static_cast<std::size_t>(end) * spt->size + u];
+    }
+    if (spt->column == nullptr) {
+        return spt->array[static_cast<std::size_t>(u) * spt->size + end];
+    }
+    assert(spt->column[end] != -1 && "Destination is not part of the demand driven tree");
+    return spt->array[static_cast<std::size_t>(spt->column[end]) * spt->size + u];
+}
+
+/**
+Sets the path of an actor to the path from start to end in the tree. Only the next intersection is looked up, the
+others are looked up one at a time by pathPop.
+
+@param path The path of the actor.
+@param spt The shortest path tree, it has to outlive the path.
+@param start The start of the path.
+@param end The destination.
+*/
+void setTreePath(actorPath_t* path, const spt_t* spt, const int start, const int end);
+
+/**
+Sets the path of an actor to a path retrieved by another router.
+
+@param path The path of the actor.
+@param queued The intersections after the start up to the destination.
+*/
+void setQueuedPath(actorPath_t* path, Path&& queued);
+
+/**
+Whether the actor has arrived, i.e. there is no intersection left on its path.
+
+@param path The path of the actor.
+*/
+inline bool pathEmpty(const actorPath_t* path)
+{
+    return path->queued ? path->queued->empty() : path->next == -1;
+}
+
+/**
+Returns the next intersection on the path.
+
+@param path The path of the actor, it may not be empty.
+*/
+inline int pathFront(const actorPath_t* path)
+{
+    assert(!pathEmpty(path) && "The path is empty");
+    return path->queued ? path->queued->front() : path->next;
+}
+
+/**
+Removes the next intersection from the path, i.e. the actor entered the street to it. For paths in a tree, the
+intersection after it is looked up in the tree.
+
+@param path The path of the actor, it may not be empty.
+*/
+inline void pathPop(actorPath_t* path)
+{
+    assert(!pathEmpty(path) && "The path is empty");
+    if (path->queued) {
+        path->queued->pop();
+    }
+    else {
+        path->next = (path->next == path->end) ? -1 : nextHop(path->tree, path->next, path->end);
+    }
+}
+
+/**
+Returns the intersections left on the path without changing it.
+
+@param path The path of the actor.
+*/
+std::vector<int> pathIntersections(const actorPath_t* path);
+
+/**
+Whether the tree knows the length of its paths, i.e. pathDistance can be used.
+
+@param spt The shortest path tree.
+*/
+inline bool hasDistances(const spt_t* spt)
+{
+    return spt->chains != nullptr || spt->distance != nullptr;
+}
+
+/**
+Returns the length of the shortest path from u to end without walking it, see spt_t::distance.
+
+@param spt The shortest path tree, hasDistances has to be true.
+@param u The start of the path.
+@param end The destination.
+
+@return The length of the path, 1e30 if end is not reachable from u.
+*/
+inline double pathDistance(const spt_t* spt, const int u, const int end)
+{
+    if (spt->chains != nullptr) {
+        return contractedDistance(spt->chains, u, end);
+    }
+    assert(spt->distance != nullptr && "The tree doesn't keep its distances");
+    if (spt->destinationMajor) {
+        return spt->distance[static_cast<std::size_t>(end) * spt->size + u];
+    }
+    if (spt->column == nullptr) {
+        return spt->distance[static_cast<std::size_t>(u) * spt->size + end];
+    }
+    assert(spt->column[end] != -1 && "Destination is not part of the demand driven tree");
+    return spt->distance[static_cast<std::size_t>(spt->column[end]) * spt->size + u];
+}
+
+/**
+Returns the estimated travel time from u to end at a constant velocity without walking the path.
+
+@param spt The shortest path tree, hasDistances has to be true.
+@param u The start of the path.
+@param end The destination.
+@param velocity The velocity in m/s.
+
+@return The travel time in s, 1e30 if end is not reachable from u.
+*/
+inline double estimatedTravelTime(const spt_t* spt, const int u, const int end, const double velocity)
+{
+    const double distance = pathDistance(spt, u, end);
+    return (distance < 1e30) ? distance / velocity : 1e30;
+}
+
+/**
+Weight of a street in the shortest path computation.
+
+@param street The street.
+
+@return The length of the street, or with ALTFW the length divided by the speed limit and the width.
+*/
+double streetWeight(const Street& street);
+
+// Implementations of the Floyd Warshall algorithm which can be chosen at runtime.
+enum FWBackend {
+    CudaFW, // FloydWarshal in fastFW.cu, only available if compiled with USE_CUDA
+    BlockedFW, // FloydWarshalBlocked in cpuFW.cpp, tiled and parallelized with OpenMP
+    NaiveFW // FloydWarshalNaive in cpuFW.cpp, single threaded reference implementation
+};
+
+#ifdef USE_CUDA
+#define DEFAULT_FW_BACKEND FWBackend::CudaFW
+#else
+#define DEFAULT_FW_BACKEND FWBackend::BlockedFW
+#endif
+
+/**
+Parses the name of a Floyd Warshall backend given on the command line.
+
+@param name One of "cuda", "cpu" or "naive".
+@param backend Set to the parsed backend.
+
+@return True <=> the name is a known backend.
+*/
+bool parseFWBackend(const std::string& name, FWBackend& backend);
+
 /**
 Calculates the shortest path tree for the given world.
 
 @param world The world to calculate the shortest path tree for.
 @param include The types of streets to include in the calculation.
+@param backend The implementation of the Floyd Warshall algorithm to use.
+@param keepDistance Whether the distances are kept as companion of the tree, see spt_t::distance.
 
 @return The shortest path tree.
 */
-spt_t calculateShortestPathTree(const world_t* world, const std::vector<StreetTypes>& include);
+spt_t calculateShortestPathTree(const world_t* world, const std::vector<StreetTypes>& include, FWBackend backend = DEFAULT_FW_BACKEND, bool keepDistance = false);
+
+/**
+Calculates the shortest path trees for cars ({Both, OnlyCar}) and bikes ({Both, OnlyBike}) with one run of Floyd
+Warshall on both graphs interleaved. The trees are the same as the ones of two calls to calculateShortestPathTree.
+
+@param world The world to calculate the shortest path trees for.
+@param carTree Set to the tree for cars.
+@param bikeTree Set to the tree for bikes.
+@param backend The implementation of the Floyd Warshall algorithm to use, the naive one runs twice.
+@param keepDistance Whether the distances are kept as companion of the trees, see spt_t::distance.
+*/
+void calculateShortestPathTrees(const world_t* world, spt_t* carTree, spt_t* bikeTree, FWBackend backend = DEFAULT_FW_BACKEND, bool keepDistance = false);
+
+/**
+Calculates the shortest path tree for the given world like calculateShortestPathTree, for maps whose Floyd Warshall
+matrices don't fit into memory. It runs FloydWarshalOutOfCore, so a run which was killed resumes from the checkpoint in
+the scratch file. The tree itself is memory mapped from the unlinked file scratch.tree.
+
+@param world The world to calculate the shortest path tree for.
+@param include The types of streets to include in the calculation.
+@param scratch The name of the scratch file, it is not deleted.
+@param destinationMajor Whether the tree is stored in the destination-major layout.
+
+@return The shortest path tree, its array is nullptr if the scratch files couldn't be created.
+*/
+spt_t calculateShortestPathTreeOutOfCore(const world_t* world, const std::vector<StreetTypes>& include, const char* scratch, bool destinationMajor);
+
+/**
+Expands any shortest path tree (neighbour slots, contracted chains, either layout) to a full source-major tree with
+intersection ids.
+
+@param tree The tree to expand, it is not changed.
+
+@return The full tree with intersection ids.
+*/
+spt_t expandShortestPathTree(const spt_t* tree);
+
+/**
+Calculates the distances of all paths of a full source-major tree with intersection ids by walking the paths towards each
+destination once. This is O(V * V), so the distances Floyd Warshall threw away can be recovered from a saved tree.
+
+@param world The world the tree was calculated for.
+@param include The types of streets the tree was calculated for.
+@param tree The tree.
+
+@return Array of size V * V, the distance from i to j at i * V + j, 1e30 if j is not reachable. Delete with delete[].
+*/
+double* shortestPathDistances(const world_t* world, const std::vector<StreetTypes>& include, const spt_t* tree);
+
+/**
+Finds the edges whose weight differs between two worlds with the same intersections.
+
+@param before The world before the changes.
+@param after The world after the changes.
+@param include The types of streets to compare.
+
+@return The changed edges, with the weight of the shortest street between the intersections before and after.
+*/
+std::vector<edgeChange_t> findEdgeChanges(const world_t* before, const world_t* after, const std::vector<StreetTypes>& include);
+
+/**
+Updates a full source-major tree with intersection ids and its distances after some edges changed, instead of running
+Floyd Warshall again. Only the affected parts are repaired: for every edge which got longer or was removed, the sources
+below it in the tree of a destination are invalidated and settled again with Dijkstra from their unaffected neighbours,
+then each edge which got shorter or was added relaxes the sources which reach its start faster and the destinations
+which are reached faster from its end.
+
+@param world The world after the changes.
+@param include The types of streets of the tree.
+@param tree The tree of the world before the changes, updated in place.
+@param distance The distances of the tree, see shortestPathDistances, updated in place.
+@param changes The changed edges, see findEdgeChanges.
+
+@return The number of (source, destination) pairs whose path used a longer or removed edge and was repaired.
+*/
+std::size_t updateShortestPathTree(const world_t* world, const std::vector<StreetTypes>& include, spt_t* tree, double* distance, const std::vector<edgeChange_t>& changes);
+
+/**
+Transposes a full shortest path tree with intersection ids and its distances in place between the source-major layout
+computed by Floyd Warshall and the destination-major layout.
+
+@param spt The shortest path tree.
+*/
+void transposeShortestPathTree(spt_t* spt);
+
+/**
+The bits per entry a full shortest path tree of the world would be encoded with, see encodeNeighbourSlots.
+
+@param world The world.
+@param include The types of streets the tree is calculated for.
+
+@return 4 or 8, 0 if an intersection has too many neighbours for neighbour slots.
+*/
+int neighbourSlotBits(const world_t* world, const std::vector<StreetTypes>& include);
+
+/**
+Encodes a full shortest path tree with neighbour slots, 4 bits per entry if no intersection has more than 15 distinct
+outbound neighbours, 8 bits if none has more than 255.
+
+@param world The world the tree was calculated for.
+@param include The types of streets the tree was calculated for.
+@param tree The full shortest path tree with intersection ids, it is not changed. The encoded tree keeps its layout and distances.
+@param encoded Set to the encoded tree.
+
+@return True <=> the tree could be encoded, false if an intersection has too many neighbours or tree isn't full.
+*/
+bool encodeNeighbourSlots(const world_t* world, const std::vector<StreetTypes>& include, const spt_t* tree, spt_t* encoded);
+
+/**
+Finds the degree 2 chains of the street graph, see chains_t. Intersections on a cycle without any other intersection
+are kept in the reduced graph, one per cycle.
+
+@param world The world to contract.
+@param include The types of streets to include.
+
+@return The chains, without the tree of the reduced graph.
+*/
+chains_t* contractChains(const world_t* world, const std::vector<StreetTypes>& include);
+
+/**
+Calculates the shortest path tree for the given world like calculateShortestPathTree, but Floyd Warshall only runs on
+the reduced graph without the degree 2 chains. The paths have the same length as the ones of the full tree.
+
+@param world The world to calculate the shortest path tree for.
+@param include The types of streets to include in the calculation.
+@param backend The implementation of the Floyd Warshall algorithm to use.
+
+@return The shortest path tree with chains set.
+*/
+spt_t calculateContractedShortestPathTree(const world_t* world, const std::vector<StreetTypes>& include, FWBackend backend = DEFAULT_FW_BACKEND);
+
+/**
+Builds the reversed street graph, i.e. the edges of a vertex are its inbound streets and their targets are the start
+intersections of the streets.
+
+@param world The world to build the graph for.
+@param include The types of streets to include in the graph.
+@param weights The weight of every street in the order of world->streets, streetWeight if nullptr.
+
+@return The reversed graph in compressed sparse row format.
+*/
+csr_t buildReverseGraph(const world_t* world, const std::vector<StreetTypes>& include, const std::vector<double>* weights = nullptr);
+
+/**
+Calculates the shortest path tree towards a single destination with Dijkstra's algorithm on the reversed graph.
+
+@param graph The reversed street graph.
+@param destination The destination of the tree.
+@param next Array of size V, set to the next intersection towards the destination, -1 if it is not reachable.
+@param distance Array of size V, set to the distance to the destination.
+*/
+void reverseDijkstra(const csr_t& graph, const int destination, int* next, double* distance);
+
+/**
+Calculates the shortest path trees of the given destinations only. One Dijkstra per destination runs in parallel.
+Memory is V * destinations instead of V * V, so it works for maps where Floyd Warshall is not possible.
+
+@param world The world to calculate the shortest path trees for.
+@param include The types of streets to include in the calculation.
+@param destinations The destinations, duplicates are ignored.
+@param weights The weight of every street in the order of world->streets, streetWeight if nullptr. The distances of
+the tree are in the unit of the weights.
+
+@return The demand driven shortest path tree with distances, only valid for paths to the given destinations.
+*/
+spt_t calculateDestinationTrees(const world_t* world, const std::vector<StreetTypes>& include, const std::vector<int>& destinations, const std::vector<double>* weights = nullptr);
+
+/**
+Estimates the current travel time of every street from the actors on it. Empty streets are driven at the speed limit,
+the others at the mean velocity of their actors, but not slower than REROUTE_MIN_VELOCITY.
+
+@param world The world in its current state.
+
+@return The travel time in s of every street in the order of world->streets.
+*/
+std::vector<double> congestedStreetWeights(const world_t* world);
+
+/**
+Estimates the travel time every street had during a simulation from its accumulated density and traffic count with
+Little's law: the mean number of actors on the street divided by the actors entering it per second. Streets no actor
+entered are driven at the speed limit.
+
+@param world The world after the simulation, the accumulators may not have been reset by jsonDumpStats.
+@param timeDelta The time step of the simulation.
+
+@return The travel time in s of every street in the order of world->streets.
+*/
+std::vector<double> experiencedStreetWeights(const world_t* world, const float timeDelta);
+
+/**
+Updates demand driven trees for changed street weights, warm started from the trees of the old weights. The column of a
+destination is only recomputed with Dijkstra if its tree uses a street which got longer or a street got short enough to
+improve a path to it, the others are copied.
+
+@param world The world the tree was calculated for.
+@param include The types of streets of the tree.
+@param tree The demand driven tree with distances of the old weights, it is not changed.
+@param before The old weight of every street in the order of world->streets.
+@param after The new weight of every street in the order of world->streets.
+@param recomputed Set to the number of recomputed destinations if not nullptr.
+
+@return The demand driven tree with distances of the new weights, for the same destinations.
+*/
+spt_t updateDestinationTrees(const world_t* world, const std::vector<StreetTypes>& include, const spt_t* tree, const std::vector<double>& before, const std::vector<double>& after, int* recomputed = nullptr);
+
+/**
+Returns the destinations of the actors of the given type which are routed with a tree and haven't arrived yet.
+
+@param world The world.
+@param type The type of the actors.
+*/
+std::vector<int> activeDestinations(const world_t* world, const ActorTypes type);
+
+/**
+Switches the actors which are routed with a tree and haven't arrived yet to new trees. Actors on a street keep driving
+to its end and take the next hops of the new tree from there, waiting actors take the first hop of the new tree.
+
+@param world The world.
+@param carsSPT The new tree of the cars, it has to contain the activeDestinations of the cars and outlive their paths.
+@param bikeSPT The new tree of the bikes, it has to contain the activeDestinations of the bikes and outlive their paths.
+*/
+void rerouteActors(world_t* world, const spt_t* carsSPT, const spt_t* bikeSPT);
 
 /**
 Retrieves the path from start to end.
@@ -35,6 +532,17 @@ Retrieves the path from start to end.
 */
 Path retrievePath(spt_t* spt, const int &start, const int &end);
 
+/**
+Retrieves the paths of many agents at once. The queries are grouped by destination, so consecutive walks read the same
+column of the tree, and the groups are walked in parallel.
+
+@param spt The shortest path tree.
+@param queries The start and end of every path.
+
+@return The paths in the order of the queries.
+*/
+std::vector<Path> retrievePaths(spt_t* spt, const std::vector<std::pair<int, int>>& queries);
+
 /**
 
 Calculates the distance of an actor from its path.
@@ -42,7 +550,7 @@ Calculates the distance of an actor from its path.
 @param actor A pointer to the actor object.
 @return The distance of the actor from its path.
 */
-float distanceFromPath(const world_t* world, actor_t* actor);
+float distanceFromPath(const world_t* world, const actor_t* actor);
 
 /**
 
@@ -51,7 +559,7 @@ Calculates the intersection path of an actor in the world.
 @param world A pointer to the world object.
 @return A vector of strings representing the IDs of the streets in the actor's path.
 */
-std::vector<std::string> getPath(actor_t* actor, const world_t* world);
+std::vector<std::string> getPath(const actor_t* actor, const world_t* world);
 
 /**
 
@@ -60,4 +568,4 @@ Calculates the street path of afn actor in the world.
 @param world A pointer to the world object.
 @return A vector of strings representing the IDs of the streets in the actor's path.
 */
-std::vector<std::string> StreetPath(actor_t* actor, const world_t* world);
\ No newline at end of file
+std::vector<std::string> StreetPath(const actor_t* actor, const world_t* world);
\ No newline at end of file
@@ -6,6 +6,8 @@
 #define LANE_WIDTH 2 // A lane is per default 2 meters
 #define DISTANCE_TO_CROSSING_FOR_TELEPORT 0.5f // Meters after which an agent may be teleported
 #define SAFETY_TIME_HEADWAY 0.5f // 1.6 seconds headway
+#define CHUNKS_PER_THREAD 8 // Number of street chunks per thread, so the threads can balance the work
+#define INTERSECTION_CHUNK 64 // Number of intersections a thread takes at once
 
 typedef struct FrontVehicles {
     Actor* frontVehicle = nullptr;
@@ -15,32 +17,43 @@ typedef struct FrontVehicles {
 
 typedef std::vector<Actor*>::iterator TrafficIterator;
 
+typedef struct WorkChunk {
+    int first; // First item of the chunk
+    int last; // Item after the chunk
+    std::size_t cost;
+} workChunk_t;
+
 /**
 Locates the vehicle in front, in front and to the immediate right and in front and to the immediate left
 of the selected actor.
 
-@param street Selected street in which vehicle is stored
-@param actor Pointer to vehicle in street->traffic
-@param trafficStart start of Traffic
-@param trafficEnd End pointer of traffic
+@param street Selected street in which vehicle is stored, with lanes prepared by prepareLanes
+@param actor Pointer to vehicle in street->traffic which is currently updated
 
 @returns Returns a FrontVehicle struct containing the front vehicle, the front vehicle to the left and the front vehicle to the right.
 */
-FrontVehicles GetFrontVehicles(const Street* street, const Actor* actor, const TrafficIterator& trafficStart, TrafficIterator& trafficEnd);
+FrontVehicles GetFrontVehicles(const Street* street, const Actor* actor);
 
 /**
 Gives the three vehicles which could collide with our actor
 
-@param street Street to query on
+@param street Street to query on, with lanes prepared by prepareLanes
 @param actor Actor for which collisions are queried
-@param start Start of traffic
  */
-FrontVehicles GetCollisionVehicles(const Street* street, const Actor* actor, const TrafficIterator start);
+FrontVehicles GetCollisionVehicles(const Street* street, const Actor* actor);
+
+/**
+Splits the traffic of a street into its lanes before the actors are updated in the order of traffic.
+
+@param street Street with sorted traffic
+*/
+void prepareLanes(Street* street);
+
 /**
 Finds the optimal Lane to drive for the vehicle and moves it to said lane. It then returns the
 vehicle in front if there is one.
 
-@param street Selected street in which vehicle is stored
+@param street Selected street in which vehicle is stored, with lanes prepared by prepareLanes
 @param actor Pointer to vehicle in street->traffic
 
 @returns Pointer to Vehicle in Front
@@ -48,7 +61,19 @@ vehicle in front if there is one.
 Actor* moveToOptimalLane(Street* street, Actor* actor);
 
 /**
-Updates all vehicles in all streets
+Splits items into consecutive chunks of about the same cost. An item which would push a chunk past the target cost
+starts a new chunk, so items which cost more than a chunk get a chunk of their own.
+
+@param costs Cost of every item
+@param chunks Number of chunks to aim for
+
+@returns The chunks, the most expensive one first
+*/
+std::vector<WorkChunk> balancedChunks(const std::vector<std::size_t>& costs, const int chunks);
+
+/**
+Updates all vehicles in all streets. The streets are split into chunks by the number of actors on them, which the threads
+take one after the other, starting with the most expensive one.
 
 @param world, World instance to update
 @param timeDelta Time past since last frame
@@ -92,6 +117,33 @@ Updates all Intersections in the world.
 @returns void.
 */
 void updateIntersections(world_t* world, const float timeDelta, bool stupidIntersections, const float current_time);
+
+/**
+One time step, updateIntersections followed by updateStreets, in a single parallel region. The phases are separated by
+barriers instead of starting a new team of threads for each of them, which dominates the step on small maps.
+
+@param world: World instance to update.
+@param timeDelta: Time past since last frame.
+@param stupidIntersections: Intersection will not check if a road is empty and still try to route its traffic for the green phase.
+@param currentTime: Needed to indicate the start and arrival time of the cars.
+
+@returns The result of updateStreets.
+*/
+bool updateStep(world_t* world, const float timeDelta, bool stupidIntersections, const float current_time);
+
+/**
+The phases of updateStep for a parallel region which runs many steps, so the team of threads is only started once.
+Every thread of the region has to call it, it returns once the step is done on all of them.
+
+@param world: World instance to update.
+@param timeDelta: Time past since last frame.
+@param stupidIntersections: Intersection will not check if a road is empty and still try to route its traffic for the green phase.
+@param currentTime: Needed to indicate the start and arrival time of the cars.
+@param chunks: Street chunks shared by the team, see balancedChunks.
+@param actorMoved: Flag shared by the team, set to 1 if an actor moved. It is not reset, the result of updateStep is
+actorMoved || emptynessOfStreets(world).
+*/
+void updateStepInTeam(world_t* world, const float timeDelta, bool stupidIntersections, const float current_time, std::vector<WorkChunk>& chunks, int& actorMoved);
 /**
 Compute the desired distance between the vehicle and the border of the next vehicle.
 
@@ -103,6 +155,18 @@ Compute the desired distance between the vehicle and the border of the next vehi
 */
 float dynamicBrakingDistance(const Actor* actor, const float &delta_velocity, const bool vehicleInFront);
 
+/**
+Computes the acceleration of the intelligent driver model with dynamicBrakingDistance as the desired gap. Integer
+exponents are computed by repeated squaring, which differs from std::pow by a few ulp.
+
+@param actor Actor with updated position and velocity
+@param frontVehicle Vehicle in front of the actor, nullptr if there is none
+@param maxDrivableDistance Distance the actor can drive until it reaches the vehicle in front or the intersection
+
+@returns The acceleration of the actor.
+*/
+float idmAcceleration(const Actor* actor, const Actor* frontVehicle, const float maxDrivableDistance);
+
 /**
 If no car could move, this function will remove cars fom roads and insert them some time later to resolve a deadlock.
 
@@ -111,6 +175,26 @@ If no car could move, this function will remove cars fom roads and insert them s
 */
 void resolveDeadLocks(world_t* world, const float current_time);
 
+/**
+Order of the traffic on a street, by distance to the intersection, then distance to the right, then address.
+
+@param a First actor
+@param b Second actor
+
+@returns True <=> a comes before b
+*/
+bool trafficOrder(const Actor* a, const Actor* b);
+
+/**
+Moves a single actor to its place in otherwise sorted traffic.
+
+@param traffic Traffic of a street, sorted by trafficOrder except for one actor
+@param index Index of the actor which is out of place
+
+@returns New index of the actor
+*/
+std::size_t restoreTrafficOrder(std::vector<Actor*>& traffic, std::size_t index);
+
 /**
 
 Updates the actors in the world on the streets in a stride pattern.
@@ -134,10 +218,43 @@ Markes the actors in a world at the intersections in stride pattern for update.
 void singleIntersectionStrideUpdate(world_t* world, const float timeDelta, bool stupidIntersections, const float current_time, const int stride, const int offset);
 
 /**
-Checks if streets are empty
+Checks if every actor has arrived, i.e. if no actor is waiting to depart or driving. Actors which couldn't be routed
+never enter the simulation and don't count.
+@param world A pointer to the world object.
+*/
+bool drained(world_t* world);
+
+/**
+Checks if streets are empty, i.e. if no street is active.
+@param world A pointer to the world object.
 */
 bool emptynessOfStreets(world_t* world);
 
+/**
+Lists the streets with traffic and the intersections with a traffic light or traffic on an inbound street in
+World::activeStreets and World::activeIntersections, and the departures of the waiting actors in World::departures, by
+going through the whole world. Counts the waiting, driving and arrived actors, which refreshActiveSets keeps up to date. The update functions call it
+when World::activeSetsValid is false, e.g. after the actors were put on their intersections or the world was reset.
+@param world A pointer to the world object.
+*/
+void buildActiveSets(world_t* world);
+
+/**
+Updates the active streets and intersections after actors moved, only looking at the active ones and the streets actors
+entered (Intersection::entered), so it doesn't depend on the size of the map. Intersections whose first waiting actor
+may not depart yet are put into World::departures.
+@param world A pointer to the world object.
+@param current_time The current time of the simulation.
+*/
+void refreshActiveSets(world_t* world, const float current_time);
+
+/**
+Makes the intersections whose first waiting actor may depart by now ready and active, taking them from World::departures.
+@param world A pointer to the world object.
+@param current_time The current time of the simulation.
+*/
+void releaseDepartures(world_t* world, const float current_time);
+
 /**
 Teleports the actor
 */
@@ -145,7 +262,8 @@ void teleportActor(Actor* actor, Street* target, int distanceToRight);
 
 /**
 Execute the result of the singleIntersectionStrideUpdate. The previous function sets flags which this function uses to perform the update
-The previous function runs in parallel where as this function runs sequentially to prevent segfaults.
+Runs in parallel: actors leaving a street are erased by its end intersection, actors entering it are handed over via Street::incoming.
+@param world A pointer to the world object.
 */
 void updateData(world_t* world);
 
@@ -26,6 +26,35 @@ Given the World and the SPT, returnes a random path starting at start, and endin
 @returns void, Everything over passed by reference.
 */
 void choseRandomPath(const world_t* world, spt_t* spt, int& start, int& end);
+/**
+Allocates the actors of the world in one block, actors[i] points to the i-th of them. They are freed together with the
+world. Must be called before any actor is created, since the block can't grow without moving the actors.
+
+@param world, world on which to operate
+@param count, number of actors
+*/
+void allocateActors(world_t* world, const std::size_t count);
+
+/**
+Adds the id of an agent to the id table of the world.
+
+@param world, world on which to operate
+@param id, id of the agent
+
+@returns the index of the id, to be stored in Actor::id
+*/
+int addAgentId(world_t* world, const std::string& id);
+
+/**
+Gives the id of an agent from the id table of the world.
+
+@param world, world of the actor
+@param actor, actor whose id is returned
+
+@returns the id of the agent
+*/
+std::string agentId(const world_t* world, const Actor* actor);
+
 /**
 Function populates the actors of the world.
 
@@ -0,0 +1,1131 @@
+/*
+This C++ program contains the micro benchmarks of the simulation.
+The first argument selects the benchmark, the remaining arguments are passed on to it:
+- fw: Compares the implementations of the Floyd Warshall algorithm on a map. It reports the time per backend and
+      checks that every backend produces the same next hops as the first one. Differing next hops are only allowed if
+      they are ties, i.e. the path they lead to has the same length.
+- pair: Compares two runs of the blocked Floyd Warshall for the car and the bike tree with the fused run which computes
+        both trees at once. The next hops of the fused trees have to be the same as the ones of the separate runs.
+- update: Changes random roads of a map (removed, longer, shorter and new roads) and compares the incremental update
+          of the tree with Floyd Warshall on the changed map. The paths of both trees have to be equally long.
+- spt: Compares the memory and the path retrieval time of the tree with intersection ids and with neighbour slots, each
+       in the source-major and the destination-major layout, for random paths one by one and batched. Every layout has
+       to give the same next hops and paths as the tree with intersection ids.
+- chains: Compares Floyd Warshall on the car graph of a map with the tree computed on the graph with contracted degree 2
+          chains. The paths of the contracted tree have to be as long as the ones of the full tree, they may only differ
+          where two paths have the same length.
+- ch: Builds the contraction hierarchy for the cars of a map and reports the build time and the time per query for
+      random paths. Every path has to be as long as the one of the Floyd Warshall tree.
+- street: Updates a single synthetic street with 1000 vehicles on two lanes and compares the time per step with the full
+          sort of the traffic after every vehicle which the update used to do. The traffic has to stay sorted.
+- idm: Computes the accelerations of random actors with idmAcceleration of the street update and with the formula with
+       std::pow. Half of the actors have the integer exponent 10, the other half one from [8, 12] as the agent
+       generator script draws them. The accelerations may only differ by the rounding of the repeated squaring, relative
+       to the size of the terms of the formula.
+- balance: Updates many synthetic streets of which a few are congested arterials. It compares the 128 fixed strides the
+           street update used to split the streets into with the chunks balanced by traffic. Besides the time on this
+           machine it reports the time the busiest thread needs relative to a perfect split for 8, 64 and 256 threads.
+- active: Updates a ring of streets of which only a few have traffic, once with the stride updates of every street and
+          intersection like a step used to, once with the active streets and intersections. The actors have to end up
+          at the same positions.
+- spawn: Simulates a ring of intersections where a million actors depart at random times of a day. It reports the time
+         per step and the number of intersections visited per step. Every actor whose time has come has to depart.
+- step: Simulates a small ring of streets with updateIntersections and updateStreets, which start parallel regions of
+        their own, with updateStep, which starts one parallel region per step, and with updateStepInTeam in one parallel
+        region for all steps like Simulate. The actors have to end up at the same positions. Time per step with the
+        defaults, median of three runs on a machine with one core (separate / per step / all steps): 1 thread 3.6 /
+        3.0 / 2.6 us, 2 threads 59 / 50 / 43 us, 4 threads 119 / 99 / 86 us, 8 threads 289 / 231 / 222 us. With more
+        threads than cores most of the time is spent at barriers waiting for threads which are not scheduled, and the
+        runs vary by about 20%.
+- reroute: Puts random actors on the streets of a map and switches them to trees computed with congested streets. Every
+           actor on a street has to take the next hop of the new tree from the end of its street, and some of them have
+           to take another one than before.
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <set>
+#include <algorithm>
+#include <omp.h>
+
+#include "actors.hpp"
+#include "routing.hpp"
+#include "io.hpp"
+#include "utils.hpp"
+#include "ch.hpp"
+#include "update.hpp"
+
+/**
+Length of the path from start to end in the shortest path tree. Returns -1 if there is no path.
+*/
+static double pathLength(const world_t* world, spt_t* spt, const int start, const int end)
+{
+    double length = 0.0;
+    int u = start;
+    while (u != end) {
+        int v = nextHop(spt, u, end);
+        if (v == -1) {
+            return -1.0;
+        }
+        length += world->intersections.at(u).outboundCar.at(v)->length;
+        u = v;
+    }
+    return length;
+}
+
+static int benchmarkFloydWarshall(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage Benchmark fw <map-in> optional <repetitions>" << std::endl;
+        return -1;
+    }
+    const int repetitions = (argc > 3) ? std::atoi(argv[3]) : 1;
+
+    world_t world;
+    nlohmann::json import;
+    if (!loadFile(argv[2], &import)) {
+        return -1;
+    }
+    importMap(&world, &import);
+
+    std::vector<std::pair<std::string, FWBackend>> backends = {
+#ifdef USE_CUDA
+        {"cuda", FWBackend::CudaFW},
+#endif
+        {"cpu", FWBackend::BlockedFW},
+        {"naive", FWBackend::NaiveFW},
+    };
+
+    std::vector<double> seconds;
+    spt_t reference = {.array = nullptr, .size = 0};
+    int mismatches = 0;
+
+    for (const auto& [name, backend] : backends) {
+        double best = 1e30;
+        spt_t tree = {.array = nullptr, .size = 0};
+
+        for (int r = 0; r < repetitions; r++) {
+            freeSPT(&tree);
+            auto start = std::chrono::high_resolution_clock::now();
+            tree = calculateShortestPathTree(&world, {StreetTypes::Both, StreetTypes::OnlyCar}, backend);
+            auto stop = std::chrono::high_resolution_clock::now();
+            best = std::min(best, std::chrono::duration<double>(stop - start).count());
+        }
+        seconds.push_back(best);
+
+        if (reference.array == nullptr) {
+            reference = tree;
+            continue;
+        }
+
+        // Compare with the first backend, a different next hop is only allowed if it is a tie.
+        int ties = 0;
+        for (int i = 0; i < tree.size; i++) {
+            for (int j = 0; j < tree.size; j++) {
+                if (tree.array[i * tree.size + j] == reference.array[i * tree.size + j]) {
+                    continue;
+                }
+                double a = pathLength(&world, &reference, i, j);
+                double b = pathLength(&world, &tree, i, j);
+                if (std::abs(a - b) <= 1e-6 * std::max(1.0, a)) {
+                    ties++;
+                }
+                else {
+                    mismatches++;
+                }
+            }
+        }
+        std::cout << name << ": " << ties << " next hops differ from " << backends.front().first
+                  << " because of ties in the path length" << std::endl;
+        freeSPT(&tree);
+    }
+
+    std::cout << std::endl << "V = " << world.intersections.size() << ", best of " << repetitions << std::endl;
+    for (std::size_t i = 0; i < backends.size(); i++) {
+        std::cout << std::left << std::setw(8) << backends[i].first << std::fixed << std::setprecision(4)
+                  << seconds[i] << " s" << "  speedup " << seconds.back() / seconds[i] << std::endl;
+    }
+
+    if (mismatches > 0) {
+        std::cerr << mismatches << " next hops lead to paths of different length!" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+static int benchmarkFusedPair(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage Benchmark pair <map-in> optional <repetitions>" << std::endl;
+        return -1;
+    }
+    const int repetitions = (argc > 3) ? std::atoi(argv[3]) : 1;
+
+    world_t world;
+    nlohmann::json import;
+    if (!loadFile(argv[2], &import)) {
+        return -1;
+    }
+    importMap(&world, &import);
+
+    double separate = 1e30;
+    double fused = 1e30;
+    spt_t cars = {.array = nullptr, .size = 0};
+    spt_t bikes = {.array = nullptr, .size = 0};
+    spt_t fusedCars = {.array = nullptr, .size = 0};
+    spt_t fusedBikes = {.array = nullptr, .size = 0};
+
+    for (int r = 0; r < repetitions; r++) {
+        freeSPT(&cars);
+        freeSPT(&bikes);
+        auto start = std::chrono::high_resolution_clock::now();
+        cars = calculateShortestPathTree(&world, {StreetTypes::Both, StreetTypes::OnlyCar}, FWBackend::BlockedFW);
+        bikes = calculateShortestPathTree(&world, {StreetTypes::Both, StreetTypes::OnlyBike}, FWBackend::BlockedFW);
+        auto stop = std::chrono::high_resolution_clock::now();
+        separate = std::min(separate, std::chrono::duration<double>(stop - start).count());
+
+        freeSPT(&fusedCars);
+        freeSPT(&fusedBikes);
+        start = std::chrono::high_resolution_clock::now();
+        calculateShortestPathTrees(&world, &fusedCars, &fusedBikes, FWBackend::BlockedFW);
+        stop = std::chrono::high_resolution_clock::now();
+        fused = std::min(fused, std::chrono::duration<double>(stop - start).count());
+    }
+
+    // Both runs do the same additions in the same order, so the trees have to be identical.
+    const std::size_t entries = static_cast<std::size_t>(cars.size) * cars.size;
+    int mismatches = 0;
+    for (std::size_t e = 0; e < entries; e++) {
+        mismatches += (cars.array[e] != fusedCars.array[e]) + (bikes.array[e] != fusedBikes.array[e]);
+    }
+    freeSPT(&cars);
+    freeSPT(&bikes);
+    freeSPT(&fusedCars);
+    freeSPT(&fusedBikes);
+
+    std::cout << std::endl << "V = " << world.intersections.size() << ", best of " << repetitions << std::endl;
+    std::cout << std::fixed << std::setprecision(4) << "separate " << separate << " s" << std::endl;
+    std::cout << "fused    " << fused << " s  speedup " << separate / fused << std::endl;
+
+    if (mismatches > 0) {
+        std::cerr << mismatches << " next hops of the fused trees differ from the separate trees!" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+static int benchmarkUpdate(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage Benchmark update <map-in> optional <changes-per-kind>" << std::endl;
+        return -1;
+    }
+    const int changes = (argc > 3) ? std::atoi(argv[3]) : 5;
+
+    world_t before;
+    nlohmann::json import;
+    if (!loadFile(argv[2], &import)) {
+        return -1;
+    }
+    importMap(&before, &import);
+    const std::vector<StreetTypes> include = {StreetTypes::Both, StreetTypes::OnlyCar};
+    const int V = static_cast<int>(before.intersections.size());
+
+    // Remove, lengthen and shorten random roads, and copy random roads to connect other intersections.
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<std::size_t> road(0, import["roads"].size() - 1);
+    std::uniform_int_distribution<int> intersection(0, V - 1);
+    nlohmann::json diff;
+    diff["removeRoads"] = nlohmann::json::array();
+    diff["roads"] = nlohmann::json::array();
+    std::set<std::string> used;
+    for (int c = 0; c < 3 * changes; c++) {
+        nlohmann::json changed = import["roads"][road(generator)];
+        if (!used.insert(changed["id"].get<std::string>()).second) {
+            continue;
+        }
+        if (c < changes) {
+            diff["removeRoads"].push_back(changed["id"]);
+            continue;
+        }
+        changed["distance"] = changed["distance"].get<double>() * ((c < 2 * changes) ? 3.0 : 0.3);
+        diff["roads"].push_back(changed);
+    }
+    for (int c = 0; c < changes; c++) {
+        nlohmann::json added = import["roads"][road(generator)];
+        added["id"] = "benchmark_" + std::to_string(c);
+        added["intersections"]["start"]["id"] = before.int_to_string.at(intersection(generator));
+        added["intersections"]["end"]["id"] = before.int_to_string.at(intersection(generator));
+        added["distance"] = 500.0;
+        added.erase("oppositeStreetId");
+        diff["roads"].push_back(added);
+    }
+
+    nlohmann::json edited = import;
+    if (!applyMapDiff(&edited, &diff)) {
+        return -1;
+    }
+    world_t after;
+    importMap(&after, &edited);
+
+    spt_t base = calculateShortestPathTree(&before, include, FWBackend::BlockedFW);
+    auto start = std::chrono::high_resolution_clock::now();
+    spt_t full = calculateShortestPathTree(&after, include, FWBackend::BlockedFW);
+    auto stop = std::chrono::high_resolution_clock::now();
+    const double fullSeconds = std::chrono::duration<double>(stop - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    double* distance = shortestPathDistances(&before, include, &base);
+    stop = std::chrono::high_resolution_clock::now();
+    const double distanceSeconds = std::chrono::duration<double>(stop - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    const std::vector<edgeChange_t> edges = findEdgeChanges(&before, &after, include);
+    const std::size_t repaired = updateShortestPathTree(&after, include, &base, distance, edges);
+    stop = std::chrono::high_resolution_clock::now();
+    const double updateSeconds = std::chrono::duration<double>(stop - start).count();
+
+    int mismatches = 0;
+    int ties = 0;
+    for (int u = 0; u < V; u++) {
+        for (int end = 0; end < V; end++) {
+            const double a = pathLength(&after, &full, u, end);
+            const double b = pathLength(&after, &base, u, end);
+            const double d = distance[static_cast<std::size_t>(u) * V + end];
+            if (std::abs(a - b) > 1e-6 * std::max(1.0, a) || std::abs((d >= 1e30 ? -1.0 : d) - b) > 1e-6 * std::max(1.0, b)) {
+                mismatches++;
+            }
+            ties += nextHop(&full, u, end) != nextHop(&base, u, end);
+        }
+    }
+    delete[] distance;
+    freeSPT(&base);
+    freeSPT(&full);
+
+    std::cout << std::endl << "V = " << V << ", " << edges.size() << " edges changed, " << repaired << " of "
+              << static_cast<std::size_t>(V) * V << " paths repaired" << std::endl;
+    std::cout << std::fixed << std::setprecision(4) << "floyd warshall " << fullSeconds << " s" << std::endl;
+    std::cout << "distances      " << distanceSeconds << " s" << std::endl;
+    std::cout << "update         " << updateSeconds << " s  speedup " << fullSeconds / (distanceSeconds + updateSeconds) << std::endl;
+    std::cout << ties << " next hops differ because of ties in the path length" << std::endl;
+
+    if (mismatches > 0) {
+        std::cerr << mismatches << " paths of the updated tree are not shortest paths!" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+Length of a path starting at start, -1 if two consecutive intersections of the path are not connected by a street.
+*/
+static double walkLength(const world_t* world, const int start, Path path)
+{
+    double length = 0.0;
+    int u = start;
+    while (!path.empty()) {
+        auto iter = world->intersections.at(u).outboundCar.find(path.front());
+        if (iter == world->intersections.at(u).outboundCar.end()) {
+            return -1.0;
+        }
+        length += iter->second->length;
+        u = path.front();
+        path.pop();
+    }
+    return length;
+}
+
+static int benchmarkChains(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage Benchmark chains <map-in>" << std::endl;
+        return -1;
+    }
+
+    world_t world;
+    nlohmann::json import;
+    if (!loadFile(argv[2], &import)) {
+        return -1;
+    }
+    importMap(&world, &import);
+    const std::vector<StreetTypes> include = {StreetTypes::Both, StreetTypes::OnlyCar};
+    const int V = static_cast<int>(world.intersections.size());
+
+    auto start = std::chrono::high_resolution_clock::now();
+    spt_t full = calculateShortestPathTree(&world, include, FWBackend::BlockedFW);
+    auto stop = std::chrono::high_resolution_clock::now();
+    const double fullSeconds = std::chrono::duration<double>(stop - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    spt_t contracted = calculateContractedShortestPathTree(&world, include, FWBackend::BlockedFW);
+    stop = std::chrono::high_resolution_clock::now();
+    const double contractedSeconds = std::chrono::duration<double>(stop - start).count();
+
+    int mismatches = 0;
+    int differentPaths = 0;
+    for (int u = 0; u < V; u++) {
+        for (int end = 0; end < V; end++) {
+            Path a = retrievePath(&full, u, end);
+            Path b = retrievePath(&contracted, u, end);
+            const bool reachable = u == end || !a.empty();
+            const double lengthA = walkLength(&world, u, a);
+            const double lengthB = walkLength(&world, u, b);
+            if (reachable != (u == end || !b.empty()) || lengthB < 0.0 || std::abs(lengthA - lengthB) > 1e-6 * std::max(1.0, lengthA)
+                || (u != end && nextHop(&contracted, u, end) != (b.empty() ? -1 : b.front()))) {
+                mismatches++;
+            }
+            differentPaths += a != b;
+        }
+    }
+
+    std::cout << std::endl << "V = " << V << ", reduced V = " << contracted.chains->tree.size << std::endl;
+    std::cout << std::fixed << std::setprecision(4) << "full       " << fullSeconds << " s" << std::endl;
+    std::cout << "contracted " << contractedSeconds << " s  speedup " << fullSeconds / contractedSeconds << std::endl;
+    std::cout << differentPaths << " paths differ because of ties in the path length" << std::endl;
+    freeSPT(&full);
+    freeSPT(&contracted);
+
+    if (mismatches > 0) {
+        std::cerr << mismatches << " paths of the contracted tree are not shortest paths!" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+static int benchmarkTreeLayouts(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage Benchmark spt <map-in> optional <queries>" << std::endl;
+        return -1;
+    }
+    const int queries = (argc > 3) ? std::atoi(argv[3]) : 100000;
+
+    world_t world;
+    nlohmann::json import;
+    if (!loadFile(argv[2], &import)) {
+        return -1;
+    }
+    importMap(&world, &import);
+    const std::vector<StreetTypes> include = {StreetTypes::Both, StreetTypes::OnlyCar};
+    const int V = static_cast<int>(world.intersections.size());
+
+    spt_t ids = calculateShortestPathTree(&world, include, FWBackend::BlockedFW);
+    spt_t idsTransposed = {.array = new int[static_cast<std::size_t>(V) * V], .size = V};
+    std::copy(ids.array, ids.array + static_cast<std::size_t>(V) * V, idsTransposed.array);
+    transposeShortestPathTree(&idsTransposed);
+
+    spt_t slots = {.array = nullptr, .size = 0};
+    spt_t slotsTransposed = {.array = nullptr, .size = 0};
+    if (!encodeNeighbourSlots(&world, include, &ids, &slots) || !encodeNeighbourSlots(&world, include, &idsTransposed, &slotsTransposed)) {
+        return -1;
+    }
+    std::vector<std::pair<std::string, spt_t*>> layouts = {
+        {"ids", &ids},
+        {"ids dm", &idsTransposed},
+        {"slots", &slots},
+        {"slots dm", &slotsTransposed},
+    };
+
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> intersection(0, V - 1);
+    std::vector<std::pair<int, int>> pairs(queries);
+    for (auto& [s, e] : pairs) {
+        s = intersection(generator);
+        e = intersection(generator);
+    }
+
+    int mismatches = 0;
+    for (const auto& [name, tree] : layouts) {
+        for (int u = 0; u < V; u++) {
+            for (int end = 0; end < V; end++) {
+                mismatches += nextHop(tree, u, end) != ids.array[static_cast<std::size_t>(u) * V + end];
+            }
+        }
+
+        // Keep the paths like importAgents does, the deallocation is not measured.
+        std::vector<Path> paths(queries);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int q = 0; q < queries; q++) {
+            paths[q] = retrievePath(tree, pairs[q].first, pairs[q].second);
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        const double single = std::chrono::duration<double>(stop - start).count();
+
+        start = std::chrono::high_resolution_clock::now();
+        std::vector<Path> batch = retrievePaths(tree, pairs);
+        stop = std::chrono::high_resolution_clock::now();
+        const double batched = std::chrono::duration<double>(stop - start).count();
+        mismatches += paths != batch;
+
+        const std::size_t bytes = (tree->slots != nullptr)
+            ? V * tree->rowBytes + (V + 1 + tree->neighbourOffset[V]) * sizeof(int)
+            : static_cast<std::size_t>(V) * V * sizeof(int);
+        std::cout << std::left << std::setw(10) << name << std::fixed << std::setprecision(4)
+                  << bytes / 1e6 << " MB  single " << single << " s  batched " << batched << " s" << std::endl;
+    }
+    std::cout << pairs.size() << " paths" << std::endl;
+    for (const auto& [name, tree] : layouts) {
+        freeSPT(tree);
+    }
+
+    if (mismatches > 0) {
+        std::cerr << mismatches << " next hops differ from the tree with intersection ids!" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+static int benchmarkContractionHierarchy(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage Benchmark ch <map-in> optional <queries>" << std::endl;
+        return -1;
+    }
+    const int queries = (argc > 3) ? std::atoi(argv[3]) : 100000;
+
+    world_t world;
+    nlohmann::json import;
+    if (!loadFile(argv[2], &import)) {
+        return -1;
+    }
+    importMap(&world, &import);
+    const std::vector<StreetTypes> include = {StreetTypes::Both, StreetTypes::OnlyCar};
+
+    auto start = std::chrono::high_resolution_clock::now();
+    ch_t ch = buildContractionHierarchy(&world, include);
+    auto stop = std::chrono::high_resolution_clock::now();
+    const double buildSeconds = std::chrono::duration<double>(stop - start).count();
+
+    spt_t tree = calculateShortestPathTree(&world, include);
+
+    const int V = static_cast<int>(world.intersections.size());
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> intersection(0, V - 1);
+    std::vector<std::pair<int, int>> pairs(queries);
+    for (auto& [s, e] : pairs) {
+        s = intersection(generator);
+        e = intersection(generator);
+    }
+
+    std::vector<Path> paths(queries);
+    start = std::chrono::high_resolution_clock::now();
+    for (int q = 0; q < queries; q++) {
+        paths[q] = retrievePath(&ch, pairs[q].first, pairs[q].second);
+    }
+    stop = std::chrono::high_resolution_clock::now();
+    const double querySeconds = std::chrono::duration<double>(stop - start).count();
+
+    int mismatches = 0;
+    for (int q = 0; q < queries; q++) {
+        double length = 0.0;
+        int u = pairs[q].first;
+        while (!paths[q].empty()) {
+            length += world.intersections.at(u).outboundCar.at(paths[q].front())->length;
+            u = paths[q].front();
+            paths[q].pop();
+        }
+        double expected = (pairs[q].first == pairs[q].second) ? 0.0 : pathLength(&world, &tree, pairs[q].first, pairs[q].second);
+        if (expected < 0.0) {
+            expected = 0.0; // No path, the query has to return an empty one
+        }
+        if (std::abs(length - expected) > 1e-6 * std::max(1.0, expected)) {
+            mismatches++;
+        }
+    }
+    freeSPT(&tree);
+
+    std::cout << std::endl << "V = " << V << ", " << ch.forward.size() + ch.backward.size() << " edges in the hierarchy" << std::endl;
+    std::cout << std::fixed << std::setprecision(4) << "build " << buildSeconds << " s" << std::endl;
+    std::cout << "query " << querySeconds / queries * 1e6 << " us on average over " << queries << " queries" << std::endl;
+
+    if (mismatches > 0) {
+        std::cerr << mismatches << " paths are longer than the shortest path!" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+static int benchmarkStreet(int argc, char* argv[])
+{
+    const int vehicles = (argc > 2) ? std::atoi(argv[2]) : 1000;
+    const int steps = (argc > 3) ? std::atoi(argv[3]) : 100;
+    const int lanes = (argc > 4) ? std::atoi(argv[4]) : 2;
+    const float timeDelta = 0.25f;
+
+    // Two intersections connected by one street which is long enough for all vehicles.
+    world_t world;
+    world.intersections.resize(2);
+    world.intersections[0].id = 0;
+    world.intersections[1].id = 1;
+    Street street;
+    street.start = 0;
+    street.end = 1;
+    street.type = StreetTypes::OnlyCar;
+    street.width = lanes * LANE_WIDTH;
+    street.length = 10.0f * vehicles;
+    world.streets.push_back(street);
+    world.StreetPtr.push_back(&world.streets[0]);
+    world.intersections[0].outboundCar[1] = &world.streets[0];
+    world.intersections[1].inbound.push_back(&world.streets[0]);
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> velocity(5.0f, 14.0f);
+    std::vector<Actor> actors(vehicles);
+    for (int i = 0; i < vehicles; i++) {
+        actors[i].distanceToIntersection = 1.0f + 20.0f * (i / lanes);
+        actors[i].distanceToRight = (i % lanes) * LANE_WIDTH;
+        actors[i].max_velocity = velocity(generator);
+        actors[i].target_velocity = actors[i].max_velocity;
+        actors[i].current_velocity = actors[i].max_velocity;
+        world.streets[0].traffic.push_back(&actors[i]);
+    }
+    std::vector<Actor*>& traffic = world.streets[0].traffic;
+
+    double updateSeconds = 0.0;
+    double sortSeconds = 0.0;
+    int unsorted = 0;
+    for (int step = 0; step < steps; step++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        updateStreets(&world, timeDelta);
+        auto stop = std::chrono::high_resolution_clock::now();
+        updateSeconds += std::chrono::duration<double>(stop - start).count();
+        unsorted += !std::is_sorted(traffic.begin(), traffic.end(), trafficOrder);
+
+        // What the update used to spend on sorting, one full sort per vehicle.
+        std::vector<Actor*> copy = traffic;
+        start = std::chrono::high_resolution_clock::now();
+        for (std::size_t i = 0; i < copy.size(); i++) {
+            std::sort(copy.begin(), copy.end(), trafficOrder);
+        }
+        stop = std::chrono::high_resolution_clock::now();
+        sortSeconds += std::chrono::duration<double>(stop - start).count();
+    }
+
+    std::cout << vehicles << " vehicles on " << lanes << " lanes, " << steps << " steps" << std::endl;
+    std::cout << std::fixed << std::setprecision(4) << "update " << updateSeconds / steps * 1e3 << " ms per step" << std::endl;
+    std::cout << "full sort per vehicle " << sortSeconds / steps * 1e3 << " ms per step" << std::endl;
+
+    if (unsorted > 0) {
+        std::cerr << "Traffic is not sorted after " << unsorted << " steps!" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+static int benchmarkIdm(int argc, char* argv[])
+{
+    const int count = (argc > 2) ? std::atoi(argv[2]) : 1000000;
+    const int steps = (argc > 3) ? std::atoi(argv[3]) : 10;
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> velocity(0.0f, 14.0f);
+    std::uniform_real_distribution<float> distance(0.1f, 100.0f);
+    std::uniform_real_distribution<float> exponent(8.0f, 12.0f);
+    std::vector<Actor> actors(count);
+    std::vector<Actor> fronts(count);
+    std::vector<float> maxDrivableDistance(count);
+    for (int i = 0; i < count; i++) {
+        actors[i].current_velocity = velocity(generator);
+        actors[i].target_velocity = 14.0f;
+        setAccelerationExponent(&actors[i], (i < count / 2) ? 10.0f : exponent(generator));
+        fronts[i].current_velocity = velocity(generator);
+        maxDrivableDistance[i] = distance(generator);
+    }
+    // Every other actor has a vehicle in front
+    auto front = [&fronts](const int i) -> const Actor* { return (i % 2 == 0) ? &fronts[i] : nullptr; };
+
+    std::vector<float> expected(count);
+    std::vector<float> magnitude(count);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int step = 0; step < steps; step++) {
+        for (int i = 0; i < count; i++) {
+            const Actor* actor = &actors[i];
+            const float delta = (front(i) == nullptr) ? -1 * actor->current_velocity : actor->current_velocity - front(i)->current_velocity;
+            const float freeRoad = std::pow(actor->current_velocity / actor->target_velocity, actor->acceleration_exp);
+            const float braking = std::pow(dynamicBrakingDistance(actor, delta, front(i) != nullptr) / maxDrivableDistance[i], 2.0f);
+            expected[i] = actor->acceleration * (1 - freeRoad - braking);
+            magnitude[i] = actor->acceleration * (1 + freeRoad + braking);
+        }
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    const double scalarSeconds = std::chrono::duration<double>(stop - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int step = 0; step < steps; step++) {
+        for (int i = 0; i < count; i++) {
+            actors[i].current_acceleration = idmAcceleration(&actors[i], front(i), maxDrivableDistance[i]);
+        }
+    }
+    stop = std::chrono::high_resolution_clock::now();
+    const double kernelSeconds = std::chrono::duration<double>(stop - start).count();
+
+    // A few ulp of the free road term can change the rounding of the difference to a large braking term, so the
+    // error is relative to the sum of the terms.
+    int mismatches = 0;
+    float maxError = 0.0f;
+    for (int i = 0; i < count; i++) {
+        const float error = std::abs(actors[i].current_acceleration - expected[i]) / magnitude[i];
+        maxError = std::max(maxError, error);
+        mismatches += error > 1e-6f;
+    }
+
+    std::cout << count << " actors, " << steps << " steps" << std::endl;
+    std::cout << std::fixed << std::setprecision(4) << "std::pow " << scalarSeconds / steps * 1e3 << " ms per step" << std::endl;
+    std::cout << "idmAcceleration " << kernelSeconds / steps * 1e3 << " ms per step" << std::endl;
+    std::cout << std::scientific << "max relative error " << maxError << std::endl;
+
+    if (mismatches > 0) {
+        std::cerr << mismatches << " accelerations differ from the formula per actor!" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+Time the busiest of the threads needs for tasks with the given costs. Tasks are handed out in order to the thread which
+is done first, like the dynamic schedule of OpenMP, or split into consecutive blocks of the same number of tasks, like
+the static schedule.
+*/
+static std::size_t makespan(const std::vector<std::size_t>& costs, const int threads, const bool dynamic)
+{
+    std::vector<std::size_t> load(threads, 0);
+    for (std::size_t t = 0; t < costs.size(); t++) {
+        if (dynamic) {
+            *std::min_element(load.begin(), load.end()) += costs[t];
+        }
+        else {
+            const std::size_t block = (costs.size() + threads - 1) / threads;
+            load[t / block] += costs[t];
+        }
+    }
+    return *std::max_element(load.begin(), load.end());
+}
+
+static int benchmarkBalance(int argc, char* argv[])
+{
+    const int streets = (argc > 2) ? std::atoi(argv[2]) : 20000;
+    const int arterials = (argc > 3) ? std::atoi(argv[3]) : 16;
+    const int steps = (argc > 4) ? std::atoi(argv[4]) : 10;
+
+    // Most streets have a few vehicles, the arterials have 5000 each.
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> light(0, 10);
+    std::vector<int> vehicles(streets);
+    std::size_t total = 0;
+    for (int i = 0; i < streets; i++) {
+        vehicles[i] = (i % (streets / std::max(1, arterials)) == 0) ? 5000 : light(generator);
+        total += vehicles[i];
+    }
+
+    world_t world;
+    world.intersections.resize(2);
+    world.intersections[0].id = 0;
+    world.intersections[1].id = 1;
+    world.streets.resize(streets);
+    std::vector<Actor> actors(total);
+    std::size_t next = 0;
+    for (int i = 0; i < streets; i++) {
+        Street& street = world.streets[i];
+        street.start = 0;
+        street.end = 1;
+        street.type = StreetTypes::OnlyCar;
+        street.width = 2 * LANE_WIDTH;
+        street.length = 10.0f * vehicles[i] + 100.0f;
+        world.StreetPtr.push_back(&street);
+        for (int v = 0; v < vehicles[i]; v++) {
+            Actor& actor = actors[next++];
+            actor.distanceToIntersection = 1.0f + 20.0f * (v / 2);
+            actor.distanceToRight = (v % 2) * LANE_WIDTH;
+            actor.current_velocity = actor.max_velocity;
+            street.traffic.push_back(&actor);
+        }
+    }
+
+    double strideSeconds = 0.0;
+    double chunkSeconds = 0.0;
+    for (int step = 0; step < steps; step++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        #pragma omp parallel for default(none) shared(world)
+        for (int32_t i = 0; i < 128; i++) {
+            singleStreetStrideUpdate(&world, 0.25f, 128, i);
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        strideSeconds += std::chrono::duration<double>(stop - start).count();
+
+        start = std::chrono::high_resolution_clock::now();
+        updateStreets(&world, 0.25f);
+        stop = std::chrono::high_resolution_clock::now();
+        chunkSeconds += std::chrono::duration<double>(stop - start).count();
+    }
+
+    // Cost model of the update, the same as the one of updateStreets
+    std::vector<std::size_t> costs(streets);
+    for (int i = 0; i < streets; i++) {
+        costs[i] = world.streets[i].traffic.size() + 1;
+    }
+    std::vector<std::size_t> strides(128, 0);
+    for (int i = 0; i < streets; i++) {
+        strides[i % 128] += costs[i];
+    }
+    std::size_t sum = 0;
+    for (const std::size_t cost : costs) {
+        sum += cost;
+    }
+
+    std::cout << streets << " streets, " << arterials << " arterials, " << total << " vehicles" << std::endl;
+    std::cout << std::fixed << std::setprecision(4) << "strides " << strideSeconds / steps * 1e3 << " ms per step, chunks "
+              << chunkSeconds / steps * 1e3 << " ms per step with " << omp_get_max_threads() << " threads" << std::endl;
+    std::cout << "busiest thread relative to a perfect split:" << std::endl;
+    for (const int threads : {8, 64, 256}) {
+        std::vector<std::size_t> chunkCosts;
+        for (const WorkChunk& chunk : balancedChunks(costs, threads * CHUNKS_PER_THREAD)) {
+            chunkCosts.push_back(chunk.cost);
+        }
+        const double ideal = static_cast<double>(sum) / threads;
+        // No split can be better than the most expensive street alone
+        const double bound = std::max(1.0, *std::max_element(costs.begin(), costs.end()) / ideal);
+        std::cout << std::setw(4) << threads << " threads: strides " << makespan(strides, threads, false) / ideal
+                  << ", chunks " << makespan(chunkCosts, threads, true) / ideal << ", bound " << bound << std::endl;
+    }
+    return 0;
+}
+
+/* A ring of streets, the given number of them with 5 vehicles which don't reach their intersection during the run. */
+static void buildRing(world_t* world, std::vector<Actor>& actors, const int streets, const int occupied)
+{
+    world->intersections.resize(streets);
+    world->streets.resize(streets);
+    actors.resize(5 * static_cast<std::size_t>(occupied));
+    for (int i = 0; i < streets; i++) {
+        Street& street = world->streets[i];
+        street.start = i;
+        street.end = (i + 1) % streets;
+        street.type = StreetTypes::OnlyCar;
+        street.width = 2 * LANE_WIDTH;
+        street.length = 1000.0f;
+        world->intersections[i].id = i;
+        world->intersections[i].outboundCar[street.end] = &street;
+        world->intersections[street.end].inbound.push_back(&street);
+        world->StreetPtr.push_back(&street);
+    }
+    for (int i = 0; i < streets; i++) {
+        world->IntersectionPtr.push_back(&world->intersections[i]);
+    }
+    for (int i = 0; i < occupied; i++) {
+        Street& street = world->streets[static_cast<std::size_t>(i) * streets / occupied];
+        for (int v = 0; v < 5; v++) {
+            Actor& actor = actors[5 * i + v];
+            actor.distanceToIntersection = 500.0f + 20.0f * v;
+            actor.current_velocity = actor.max_velocity;
+            street.traffic.push_back(&actor);
+        }
+    }
+}
+
+static int benchmarkActive(int argc, char* argv[])
+{
+    const int streets = (argc > 2) ? std::atoi(argv[2]) : 100000;
+    const int occupied = std::min(streets, (argc > 3) ? std::atoi(argv[3]) : 100);
+    const int steps = (argc > 4) ? std::atoi(argv[4]) : 100;
+    const float timeDelta = 0.25f;
+
+    world_t full;
+    world_t active;
+    std::vector<Actor> fullActors;
+    std::vector<Actor> activeActors;
+    buildRing(&full, fullActors, streets, occupied);
+    buildRing(&active, activeActors, streets, occupied);
+
+    // What a step did before, going through every street and intersection.
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int step = 0; step < steps; step++) {
+        singleIntersectionStrideUpdate(&full, timeDelta, false, step * timeDelta, 1, 0);
+        singleIntersectionStrideUpdateInsert(&full, step * timeDelta, 1, 0);
+        singleStreetStrideUpdate(&full, timeDelta, 1, 0);
+        bool empty = true;
+        for (const Street& street : full.streets) {
+            empty = street.traffic.empty() && empty;
+        }
+        if (empty) {
+            std::cerr << "The streets are empty" << std::endl;
+        }
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    const double fullSeconds = std::chrono::duration<double>(stop - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int step = 0; step < steps; step++) {
+        updateIntersections(&active, timeDelta, false, step * timeDelta);
+        updateStreets(&active, timeDelta);
+    }
+    stop = std::chrono::high_resolution_clock::now();
+    const double activeSeconds = std::chrono::duration<double>(stop - start).count();
+
+    int mismatches = 0;
+    for (std::size_t i = 0; i < fullActors.size(); i++) {
+        mismatches += fullActors[i].distanceToIntersection != activeActors[i].distanceToIntersection;
+    }
+
+    std::cout << streets << " streets, " << occupied << " with traffic, " << steps << " steps" << std::endl;
+    std::cout << std::fixed << std::setprecision(4) << "all streets " << fullSeconds / steps * 1e3 << " ms per step, active "
+              << activeSeconds / steps * 1e3 << " ms per step (" << active.activeStreets.size() << " streets, "
+              << active.activeIntersections.size() << " intersections)" << std::endl;
+    std::cout << mismatches << " actors at a different position" << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+static int benchmarkSpawn(int argc, char* argv[])
+{
+    const int intersections = (argc > 2) ? std::atoi(argv[2]) : 100000;
+    const int departures = (argc > 3) ? std::atoi(argv[3]) : 1000000;
+    const int steps = (argc > 4) ? std::atoi(argv[4]) : 2400;
+    const float timeDelta = 0.25f;
+
+    // Every actor drives to the next intersection of the ring, departing at some time of the day.
+    world_t world;
+    std::vector<Actor> unused;
+    buildRing(&world, unused, intersections, 0);
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> start(0, intersections - 1);
+    std::uniform_real_distribution<float> time(0.0f, 24.0f * 3600.0f);
+    std::vector<Actor> actors(departures);
+    for (Actor& actor : actors) {
+        const int intersection = start(generator);
+        actor.insertAfter = time(generator);
+        setQueuedPath(&actor.path, Path({(intersection + 1) % intersections}));
+        world.intersections[intersection].waitingToBeInserted.push_back(&actor);
+    }
+    for (Intersection& intersection : world.intersections) {
+        std::sort(intersection.waitingToBeInserted.begin(), intersection.waitingToBeInserted.end(), [](const Actor* a, const Actor* b) {
+            return a->insertAfter < b->insertAfter;
+        });
+    }
+    int waiting = 0;
+    for (const Intersection& intersection : world.intersections) {
+        waiting += !intersection.waitingToBeInserted.empty();
+    }
+
+    std::size_t visited = 0;
+    auto begin = std::chrono::high_resolution_clock::now();
+    for (int step = 0; step < steps; step++) {
+        updateIntersections(&world, timeDelta, false, step * timeDelta);
+        visited += world.activeIntersections.size();
+        updateStreets(&world, timeDelta);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    // Streets are long and nearly empty, so every actor departs in the step its time has come.
+    const float last = (steps - 1) * timeDelta;
+    int due = 0;
+    int departed = 0;
+    for (const Actor& actor : actors) {
+        due += actor.insertAfter <= last;
+        departed += actor.start_time != -1.0f;
+    }
+
+    std::cout << intersections << " intersections, " << departures << " departures over a day, " << steps << " steps" << std::endl;
+    std::cout << std::fixed << std::setprecision(4) << std::chrono::duration<double>(end - begin).count() / steps * 1e3
+              << " ms per step, " << static_cast<double>(visited) / steps << " intersections visited per step, "
+              << waiting << " with waiting actors" << std::endl;
+    std::cout << departed << " of " << due << " due actors departed" << std::endl;
+    return departed == due ? 0 : 1;
+}
+
+static int benchmarkStep(int argc, char* argv[])
+{
+    const int streets = (argc > 2) ? std::atoi(argv[2]) : 50;
+    const int occupied = std::min(streets, (argc > 3) ? std::atoi(argv[3]) : 20);
+    const int steps = (argc > 4) ? std::atoi(argv[4]) : 20000;
+    const float timeDelta = 0.25f;
+
+    // A small map, where starting the threads for every phase costs more than the phases themselves.
+    world_t separate;
+    world_t fused;
+    world_t team;
+    std::vector<Actor> separateActors;
+    std::vector<Actor> fusedActors;
+    std::vector<Actor> teamActors;
+    buildRing(&separate, separateActors, streets, occupied);
+    buildRing(&fused, fusedActors, streets, occupied);
+    buildRing(&team, teamActors, streets, occupied);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int step = 0; step < steps; step++) {
+        updateIntersections(&separate, timeDelta, false, step * timeDelta);
+        updateStreets(&separate, timeDelta);
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    const double separateSeconds = std::chrono::duration<double>(stop - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int step = 0; step < steps; step++) {
+        updateStep(&fused, timeDelta, false, step * timeDelta);
+    }
+    stop = std::chrono::high_resolution_clock::now();
+    const double fusedSeconds = std::chrono::duration<double>(stop - start).count();
+
+    // Like the time loop of Simulate, one team for all steps.
+    std::vector<WorkChunk> chunks;
+    int actorMoved = 0;
+    start = std::chrono::high_resolution_clock::now();
+    #pragma omp parallel default(none) shared(team, chunks, actorMoved, steps, timeDelta)
+    for (int step = 0; step < steps; step++) {
+        updateStepInTeam(&team, timeDelta, false, step * timeDelta, chunks, actorMoved);
+    }
+    stop = std::chrono::high_resolution_clock::now();
+    const double teamSeconds = std::chrono::duration<double>(stop - start).count();
+
+    int mismatches = 0;
+    for (std::size_t i = 0; i < separateActors.size(); i++) {
+        mismatches += separateActors[i].distanceToIntersection != fusedActors[i].distanceToIntersection
+                      || separateActors[i].end_time != fusedActors[i].end_time
+                      || separateActors[i].distanceToIntersection != teamActors[i].distanceToIntersection
+                      || separateActors[i].end_time != teamActors[i].end_time;
+    }
+
+    std::cout << streets << " streets, " << occupied << " with traffic, " << steps << " steps, " << omp_get_max_threads() << " threads" << std::endl;
+    std::cout << std::fixed << std::setprecision(2) << "separate regions " << separateSeconds / steps * 1e6
+              << " us per step, one region per step " << fusedSeconds / steps * 1e6
+              << " us per step, one region for all steps " << teamSeconds / steps * 1e6 << " us per step" << std::endl;
+    std::cout << mismatches << " actors at a different position" << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+static int benchmarkReroute(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage Benchmark reroute <map-in> optional <actors>" << std::endl;
+        return -1;
+    }
+    const int count = (argc > 3) ? std::atoi(argv[3]) : 100000;
+
+    world_t world;
+    nlohmann::json import;
+    if (!loadFile(argv[2], &import)) {
+        return -1;
+    }
+    importMap(&world, &import);
+    const std::vector<StreetTypes> include = {StreetTypes::Both, StreetTypes::OnlyCar};
+    const int V = static_cast<int>(world.intersections.size());
+
+    std::vector<Street*> carStreets;
+    for (Street& street : world.streets) {
+        if (std::find(include.begin(), include.end(), street.type) != include.end()) {
+            carStreets.push_back(&street);
+        }
+    }
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<std::size_t> road(0, carStreets.size() - 1);
+    std::uniform_int_distribution<int> intersection(0, V - 1);
+    std::vector<Street*> streets(count);
+    std::vector<int> destinations(count);
+    for (int i = 0; i < count; i++) {
+        streets[i] = carStreets[road(generator)];
+        destinations[i] = intersection(generator);
+    }
+
+    // Congest a tenth of the streets, so that the paths of many actors change.
+    std::bernoulli_distribution congested(0.1);
+    std::vector<double> weights(world.streets.size());
+    for (std::size_t s = 0; s < world.streets.size(); s++) {
+        weights[s] = streetWeight(world.streets[s]) * (congested(generator) ? 10.0 : 1.0);
+    }
+    spt_t before = calculateDestinationTrees(&world, include, destinations);
+    spt_t after = calculateDestinationTrees(&world, include, destinations, &weights);
+
+    // The actors drive on their streets, their next hop is the one after the end of the street.
+    std::vector<Actor> actors(count);
+    for (int i = 0; i < count; i++) {
+        actors[i].type = ActorTypes::Car;
+        setTreePath(&actors[i].path, &before, streets[i]->end, destinations[i]);
+        streets[i]->traffic.push_back(&actors[i]);
+        world.actors.push_back(&actors[i]);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    rerouteActors(&world, &after, &after);
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    int changed = 0;
+    int mismatches = 0;
+    for (int i = 0; i < count; i++) {
+        const int end = streets[i]->end;
+        const int expected = (end == destinations[i]) ? -1 : nextHop(&after, end, destinations[i]);
+        const int old = (end == destinations[i]) ? -1 : nextHop(&before, end, destinations[i]);
+        mismatches += actors[i].path.next != expected;
+        changed += expected != old;
+    }
+    freeSPT(&before);
+    freeSPT(&after);
+
+    std::cout << count << " actors, " << changed << " take another next hop after rerouting" << std::endl;
+    std::cout << std::fixed << std::setprecision(4) << "rerouteActors " << std::chrono::duration<double>(stop - start).count() * 1e3 << " ms" << std::endl;
+
+    if (changed == 0) {
+        std::cerr << "No next hop changed, the congestion doesn't reroute any actor!" << std::endl;
+        return -1;
+    }
+    if (mismatches > 0) {
+        std::cerr << mismatches << " actors on a street don't take the next hop of the new tree!" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage Benchmark <benchmark> <arguments>" << std::endl;
+        std::cerr << "benchmark is one of fw, pair, update, spt, chains, ch, street, idm, balance, active, spawn, step, reroute" << std::endl;
+        return -1;
+    }
+
+    const std::string benchmark = argv[1];
+    if (benchmark == "fw") {
+        return benchmarkFloydWarshall(argc, argv);
+    }
+    if (benchmark == "pair") {
+        return benchmarkFusedPair(argc, argv);
+    }
+    if (benchmark == "update") {
+        return benchmarkUpdate(argc, argv);
+    }
+    if (benchmark == "spt") {
+        return benchmarkTreeLayouts(argc, argv);
+    }
+    if (benchmark == "chains") {
+        return benchmarkChains(argc, argv);
+    }
+    if (benchmark == "ch") {
+        return benchmarkContractionHierarchy(argc, argv);
+    }
+    if (benchmark == "street") {
+        return benchmarkStreet(argc, argv);
+    }
+    if (benchmark == "idm") {
+        return benchmarkIdm(argc, argv);
+    }
+    if (benchmark == "balance") {
+        return benchmarkBalance(argc, argv);
+    }
+    if (benchmark == "active") {
+        return benchmarkActive(argc, argv);
+    }
+    if (benchmark == "spawn") {
+        return benchmarkSpawn(argc, argv);
+    }
+    if (benchmark == "step") {
+        return benchmarkStep(argc, argv);
+    }
+    if (benchmark == "reroute") {
+        return benchmarkReroute(argc, argv);
+    }
+
+    std::cerr << "Unknown benchmark " << benchmark << std::endl;
+    return -1;
+}
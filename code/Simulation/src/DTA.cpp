@@ -0,0 +1,313 @@
+/*
+This C++ program runs an iterative dynamic traffic assignment on a map with a set of agents.
+Every iteration simulates the agents, derives the travel time every street had from the statistics the simulation
+accumulates and moves a part of the agents whose route was slower than the shortest route to the shortest route.
+It stops once the relative gap between the travel times of the routes and of the shortest routes is small enough.
+The map, the agents and the shortest path trees stay in memory, the trees of an iteration are updated from the ones
+of the iteration before.
+At the end, the agents and the statistics of a simulation with the final routes are exported like Simulate does.
+*/
+
+#include <iostream>
+#include <vector>
+#include <list>
+#include <set>
+#include <cstdlib>
+#include <string>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+#include "actors.hpp"
+#include "routing.hpp"
+#include "update.hpp"
+#include "io.hpp"
+#include "utils.hpp"
+
+#define STATUS_UPDATAE_INTERVAL 60
+#define USE_STUPID_INTERSECTIONS false
+#define SLURM_OUTPUT
+#define WEIGHT_TOLERANCE 0.02 // Relative change below which the travel time of a street is kept, so fewer trees change
+
+static const std::vector<StreetTypes> carStreets = {StreetTypes::Both, StreetTypes::OnlyCar};
+static const std::vector<StreetTypes> bikeStreets = {StreetTypes::Both, StreetTypes::OnlyBike};
+
+// State of the world after the import, every iteration starts from it.
+typedef struct InitialState {
+    std::vector<float> insertAfter; // Of every actor, resolveDeadLocks changes it
+    std::vector<std::deque<Actor*>> waiting; // The waitingToBeInserted of every intersection
+    std::vector<std::pair<float, int32_t>> phase; // The currentPhase and green of every intersection
+} initialState_t;
+
+static initialState_t saveInitialState(const world_t* world)
+{
+    initialState_t initial;
+    for (const Actor* actor : world->actors) {
+        initial.insertAfter.push_back(actor->insertAfter);
+    }
+    for (const Intersection& intersection : world->intersections) {
+        initial.waiting.push_back(intersection.waitingToBeInserted);
+        initial.phase.emplace_back(intersection.currentPhase, intersection.green);
+    }
+    return initial;
+}
+
+/*
+ * Removes all actors from the streets and puts them back to their start, with their paths starting again in the tree
+ * they are routed with. The accumulated statistics are reset.
+ */
+static void resetWorld(world_t* world, const initialState_t* initial)
+{
+    for (Street& street : world->streets) {
+        street.traffic.clear();
+        street.density_accumulate_bike = 0.0f;
+        street.total_traffic_count_bike = 0;
+        street.flow_accumulate_bike = 0.0f;
+        street.density_accumulate_car = 0.0f;
+        street.total_traffic_count_car = 0;
+        street.flow_accumulate_car = 0.0f;
+    }
+    for (std::size_t i = 0; i < world->intersections.size(); i++) {
+        Intersection& intersection = world->intersections[i];
+        intersection.waitingToBeInserted = initial->waiting[i];
+        intersection.arrivedFrom.clear();
+        intersection.currentPhase = initial->phase[i].first;
+        intersection.green = initial->phase[i].second;
+        intersection.outputFlag = true;
+        intersection.car_flow_accumulate = 0.0f;
+        intersection.bike_flow_accumulate = 0.0f;
+        intersection.needsUpdate = false;
+    }
+    world->activeSetsValid = false;
+    for (std::size_t i = 0; i < world->actors.size(); i++) {
+        Actor* actor = world->actors[i];
+        actor->distanceToIntersection = 0.0f;
+        actor->distanceToRight = 0;
+        actor->current_velocity = 0.0f;
+        actor->target_velocity = 50 / 3.6f;
+        actor->current_acceleration = 0.0f;
+        actor->insertAfter = initial->insertAfter[i];
+        actor->outputFlag = false;
+        actor->start_time = -1.0f;
+        actor->end_time = -1.0f;
+        actor->time_spent_waiting = 0.0f;
+        actor->Teleport = false;
+        actor->arrived = false;
+        actor->tempDistanceToRight = 0;
+        actor->overtaking_distance = 0;
+        actor->distanceToFront = 0;
+        setTreePath(&actor->path, actor->path.tree, actor->start_id, actor->end_id);
+    }
+}
+
+static void simulate(world_t* world, const float runtime, const float deltaTime)
+{
+    float maxTime = runtime;
+    float lastStatusTime = runtime;
+    float lastDeadLockTime = runtime;
+    while (maxTime > 0.0f) {
+        lastDeadLockTime = (updateStep(world, deltaTime, USE_STUPID_INTERSECTIONS, runtime - maxTime)) ? maxTime : lastDeadLockTime;
+
+        if  (lastDeadLockTime - maxTime > 15.0f) {
+            std::cerr << "Deadlock detected at Time " << maxTime << std::endl;
+            resolveDeadLocks(world, runtime - maxTime);
+            lastDeadLockTime = maxTime;
+        }
+        maxTime -= deltaTime;
+
+        if (lastStatusTime - maxTime >= STATUS_UPDATAE_INTERVAL) {
+            lastStatusTime = maxTime;
+#ifdef SLURM_OUTPUT
+            std::cout << "Time to simulate:  " << maxTime << " remaining seconds" << std::endl;
+#else
+            std::cout << "\rTime to simulate:  " << maxTime << " remaining seconds" << std::flush;
+#endif
+        }
+    }
+    std::cout << std::endl;
+}
+
+/*
+ * Travel time of the route of the actor in the tree it is routed with.
+ */
+static double routeTime(const world_t* world, const Actor* actor, const std::vector<double>& weights)
+{
+    actorPath_t route;
+    setTreePath(&route, actor->path.tree, actor->start_id, actor->end_id);
+    double time = 0.0;
+    int u = actor->start_id;
+    for (const int v : pathIntersections(&route)) {
+        const Intersection& intersection = world->intersections.at(u);
+        const Street* street = (actor->type == ActorTypes::Bike) ? intersection.outboundBike.at(v) : intersection.outboundCar.at(v);
+        time += weights[street - world->streets.data()];
+        u = v;
+    }
+    return time;
+}
+
+/*
+ * Frees the trees no actor is routed with anymore, except for the newest one.
+ */
+static void freeUnusedTrees(const world_t* world, std::list<spt_t>* trees)
+{
+    std::set<const spt_t*> used;
+    for (const Actor* actor : world->actors) {
+        used.insert(actor->path.tree);
+    }
+    for (auto iter = trees->begin(); iter != std::prev(trees->end());) {
+        if (used.count(&*iter) == 0) {
+            freeSPT(&*iter);
+            iter = trees->erase(iter);
+        }
+        else {
+            iter++;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 10) {
+        std::cerr << "Usage DTA <mapIn> <agentsIn> <agentsOut> <statsDirOut> <runtime> <timedelta> <iterations> <reroute-fraction> <gap> optional <traffic-signals>" << std::endl;
+        std::cerr << "Iterates until the relative gap is below gap or after iterations, every iteration moves reroute-fraction" << std::endl;
+        std::cerr << "of the agents on slower routes than the shortest one to the shortest route" << std::endl;
+        std::cerr << "Make sure statsDirOut has a / as it's last character. AND DIRECTORY MUST EXIST" << std::endl;
+        return -1;
+    }
+
+    const char* map = argv[1];
+    const char* agentsIn = argv[2];
+    const char* agentsOut = argv[3];
+    const std::string statsDirOut = argv[4];
+    const float runtime = std::atof(argv[5]);
+    const float deltaTime = std::atof(argv[6]);
+    const int iterations = std::atoi(argv[7]);
+    const double rerouteFraction = std::atof(argv[8]);
+    const double targetGap = std::atof(argv[9]);
+    const bool doTrafficSignals = argc > 10 && *argv[10] == '1';
+
+    world_t world;
+    nlohmann::json import;
+    if (!loadFile(map, &import)) {
+        return -1;
+    }
+
+    std::chrono::high_resolution_clock::time_point start = startMeasureTime("importing map");
+    importMap(&world, &import, doTrafficSignals);
+    stopMeasureTime(start);
+
+    // The trees of the older iterations are kept as long as actors are routed with them.
+    std::list<spt_t> carTrees;
+    std::list<spt_t> bikeTrees;
+    std::vector<double> weights = congestedStreetWeights(&world); // No actor is on a street yet, i.e. the free flow travel times
+    {
+        nlohmann::json agents;
+        start = startMeasureTime("importing actors");
+        if (!loadFile(agentsIn, &agents)) {
+            return -1;
+        }
+        stopMeasureTime(start);
+
+        start = startMeasureTime("calculating shortest path trees with the free flow travel times");
+        carTrees.push_back(calculateDestinationTrees(&world, carStreets, agentDestinations(&world, &agents, "cars"), &weights));
+        bikeTrees.push_back(calculateDestinationTrees(&world, bikeStreets, agentDestinations(&world, &agents, "bikes"), &weights));
+        stopMeasureTime(start);
+
+        start = startMeasureTime("routing actors");
+        importAgents(&world, &agents, &carTrees.back(), &bikeTrees.back());
+        stopMeasureTime(start);
+    }
+
+    #pragma omp parallel for shared(world) default(none)
+    for (std::size_t i = 0; i < world.intersections.size(); ++i) {
+        Intersection *iter = &world.intersections.at(i);
+        std::sort(iter->waitingToBeInserted.begin(), iter->waitingToBeInserted.end(), [](const Actor* a, const Actor* b) {
+            return a->insertAfter < b->insertAfter;
+        });
+    }
+    const initialState_t initial = saveInitialState(&world);
+
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    nlohmann::json gaps = std::vector<nlohmann::json>();
+
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        start = startMeasureTime("simulating iteration " + std::to_string(iteration));
+        resetWorld(&world, &initial);
+        simulate(&world, runtime, deltaTime);
+        stopMeasureTime(start);
+
+        // Keep the travel times which barely changed, so the warm start only recomputes the trees of destinations
+        // whose streets really changed.
+        start = startMeasureTime("updating shortest path trees");
+        const std::vector<double> experienced = experiencedStreetWeights(&world, deltaTime);
+        std::vector<double> next = weights;
+        for (std::size_t i = 0; i < next.size(); i++) {
+            if (std::abs(experienced[i] - weights[i]) > WEIGHT_TOLERANCE * weights[i]) {
+                next[i] = experienced[i];
+            }
+        }
+        int recomputedCars;
+        int recomputedBikes;
+        carTrees.push_back(updateDestinationTrees(&world, carStreets, &carTrees.back(), weights, next, &recomputedCars));
+        bikeTrees.push_back(updateDestinationTrees(&world, bikeStreets, &bikeTrees.back(), weights, next, &recomputedBikes));
+        weights = std::move(next);
+        stopMeasureTime(start);
+
+        // Relative gap: how much longer the routes take than the shortest routes with the travel times of this iteration.
+        double routes = 0.0;
+        double shortest = 0.0;
+        int arrived = 0;
+        std::vector<Actor*> slower;
+        for (Actor* actor : world.actors) {
+            arrived += (actor->end_time >= 0.0f) ? 1 : 0;
+            const spt_t* tree = (actor->type == ActorTypes::Bike) ? &bikeTrees.back() : &carTrees.back();
+            if (actor->start_id < 0 || actor->end_id < 0 || actor->start_id == actor->end_id || nextHop(tree, actor->start_id, actor->end_id) == -1) {
+                continue;
+            }
+            const double best = pathDistance(tree, actor->start_id, actor->end_id);
+            const double current = routeTime(&world, actor, weights);
+            routes += current;
+            shortest += best;
+            if (current > best * (1.0 + 1e-6)) {
+                slower.push_back(actor);
+            }
+        }
+        const double gap = (shortest > 0.0) ? routes / shortest - 1.0 : 0.0;
+        std::cout << "Iteration " << iteration << ": relative gap " << gap << ", " << arrived << " of " << world.actors.size()
+                  << " agents arrived, " << slower.size() << " on slower routes, " << recomputedCars << " car and "
+                  << recomputedBikes << " bike destinations recomputed" << std::endl;
+        gaps.push_back({{"iteration", iteration}, {"gap", gap}, {"arrived", arrived}, {"slower", slower.size()}});
+        if (gap < targetGap) {
+            break;
+        }
+
+        for (Actor* actor : slower) {
+            if (uniform(generator) < rerouteFraction) {
+                actor->path.tree = (actor->type == ActorTypes::Bike) ? &bikeTrees.back() : &carTrees.back();
+            }
+        }
+        freeUnusedTrees(&world, &carTrees);
+        freeUnusedTrees(&world, &bikeTrees);
+    }
+
+    // The distances of the trees are travel times, so the travel distances are taken from the paths.
+    start = startMeasureTime("simulating the final routes");
+    resetWorld(&world, &initial);
+    nlohmann::json output = exportWorld(&world, runtime, deltaTime, &import["peripherals"]["map"]);
+    simulate(&world, runtime, deltaTime);
+    addFrame(&world, &output, true);
+    stopMeasureTime(start);
+
+    start = startMeasureTime("saving agents");
+    save(agentsOut, &output);
+
+    nlohmann::json stats;
+    jsonDumpStats(runtime, &stats, &world, true);
+    save(statsDirOut + "final.json", &stats);
+    save(statsDirOut + "gap.json", &gaps);
+    stopMeasureTime(start);
+
+    return 0;
+}
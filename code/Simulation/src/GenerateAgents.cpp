@@ -63,18 +63,17 @@ int main(int argc, char* argv[])
     else if (argc > 6) {
         start = startMeasureTime("importing shortest path trees");
         // Don't continue if loading fails.
-        if (!binLoadTree(&carsSPT, argv[6], &world)) {
+        if (!binLoadTree(&carsSPT, argv[6], &world, {StreetTypes::Both, StreetTypes::OnlyCar})) {
             return -1;
         }
-        if (!binLoadTree(&bikeSPT, argv[7], &world)) {
+        if (!binLoadTree(&bikeSPT, argv[7], &world, {StreetTypes::Both, StreetTypes::OnlyBike})) {
             return -1;
         }
         stopMeasureTime(start);
     }
     else {
         start = startMeasureTime("calculating shortest path tree with floyd warshall");
-        carsSPT = calculateShortestPathTree(&world, {StreetTypes::Both, StreetTypes::OnlyCar});
-        bikeSPT = calculateShortestPathTree(&world, {StreetTypes::Both, StreetTypes::OnlyBike});
+        calculateShortestPathTrees(&world, &carsSPT, &bikeSPT);
         stopMeasureTime(start);
     }
 
@@ -94,7 +93,7 @@ int main(int argc, char* argv[])
     }
 #endif
     start = startMeasureTime("creating random actors");
-    world.actors = std::vector<Actor*>(randomCars + randomBikes);
+    allocateActors(&world, randomCars + randomBikes);
     createRandomActors(&world, &bikeSPT, ActorTypes::Bike, 10, 25, randomCars, randomBikes, 1.5f, maxRandomTime);
     createRandomActors(&world, &carsSPT, ActorTypes::Car, 30, 120, 0, randomCars, 4.5f, maxRandomTime);
     stopMeasureTime(start);
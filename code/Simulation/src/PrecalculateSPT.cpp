@@ -11,20 +11,149 @@ including the map and actors, to and from a single JSON file.
 
 #include <iostream>
 #include <chrono>
+#include <cstdio>
+#include <string>
+#include <algorithm>
 
 #include "actors.hpp"
 #include "nlohmann/json.hpp"
 #include "utils.hpp"
 #include "io.hpp"
+#include "ch.hpp"
 //#define DDEBUG
 #define SLURM_OUTPUT
 
 
+/*
+ * Whether the tree should be calculated on the graph with contracted degree 2 chains. The contracted tree stores an int
+ * and a float per pair of the reduced graph and isn't encoded with neighbour slots, so it is only used if it is not
+ * larger than the full tree as dumpTree would write it, with neighbour slots or with ints if it can't be encoded.
+ */
+static bool worthContracting(const world_t* world, const std::vector<StreetTypes>& include)
+{
+    chains_t* chains = contractChains(world, include);
+    const std::size_t R = chains->core.size();
+    const std::size_t V = world->intersections.size();
+    delete chains;
+    const std::size_t contractedBytes = R * R * (sizeof(int) + sizeof(float));
+    const int bits = neighbourSlotBits(world, include);
+    const std::size_t fullBytes = bits == 0 ? V * V * sizeof(int) : V * ((V * bits + 7) / 8);
+    return contractedBytes <= fullBytes;
+}
+
+/*
+ * Dumps the tree with neighbour slots, or with intersection ids if it can't be encoded. With destinationMajor the tree
+ * is transposed first. Trees with contracted chains are dumped as they are. Returns false if the file couldn't be written.
+ */
+static bool dumpTree(const world_t* world, const std::vector<StreetTypes>& include, spt_t* tree, const char* file, const bool destinationMajor)
+{
+    if (destinationMajor && !tree->destinationMajor) {
+        transposeShortestPathTree(tree);
+    }
+    spt_t encoded = {.array = nullptr, .size = 0};
+    bool dumped;
+    if (tree->chains == nullptr && encodeNeighbourSlots(world, include, tree, &encoded)) {
+        dumped = binDumpSpt(&encoded, file, world, include);
+    }
+    else {
+        dumped = binDumpSpt(tree, file, world, include);
+    }
+    freeSPT(&encoded);
+    return dumped;
+}
+
+/*
+ * Loads the base tree of the map before the diff and updates it for the map after the diff. Returns false if the base
+ * tree couldn't be loaded. The layout of the base tree is returned in destinationMajor, the updated tree is source-major.
+ * The updated tree keeps its distances if the base tree had them.
+ */
+static bool updateTree(const world_t* before, const world_t* after, const std::vector<StreetTypes>& include, const char* baseFile, spt_t* tree, bool* destinationMajor)
+{
+    spt_t base = {.array = nullptr, .size = 0};
+    if (!binLoadTree(&base, baseFile, before, include)) {
+        return false;
+    }
+    *destinationMajor = base.destinationMajor;
+    *tree = expandShortestPathTree(&base);
+    const bool keepDistance = base.distance != nullptr;
+    freeSPT(&base);
+
+    double* distance = shortestPathDistances(before, include, tree);
+    const std::vector<edgeChange_t> changes = findEdgeChanges(before, after, include);
+    const std::size_t repaired = updateShortestPathTree(after, include, tree, distance, changes);
+    const std::size_t elements = static_cast<std::size_t>(tree->size) * tree->size;
+    if (keepDistance) {
+        tree->distance = new float[elements];
+        std::copy(distance, distance + elements, tree->distance);
+    }
+    delete[] distance;
+    std::cout << changes.size() << " edges changed, " << repaired << " of " << elements << " paths repaired" << std::endl;
+    return true;
+}
+
+/*
+ * The update mode: argv[6] is the map diff, argv[7] and argv[8] the trees of the map before the diff and argv[9] the
+ * file the map after the diff is written to.
+ */
+static int updateTrees(world_t* before, nlohmann::json* import, char* argv[])
+{
+    const char* carFile = argv[2];
+    const char* bikeFile = argv[3];
+    const char* janFile = argv[4];
+    nlohmann::json diff;
+    if (!loadFile(argv[6], &diff)) {
+        return -1;
+    }
+    nlohmann::json edited = *import;
+    if (!applyMapDiff(&edited, &diff)) {
+        return -1;
+    }
+    world_t after;
+    importMap(&after, &edited);
+    save(argv[9], &edited);
+
+    std::chrono::high_resolution_clock::time_point time = startMeasureTime("updating shortest path trees");
+    const std::vector<StreetTypes> carStreets = {StreetTypes::Both, StreetTypes::OnlyCar};
+    const std::vector<StreetTypes> bikeStreets = {StreetTypes::Both, StreetTypes::OnlyBike};
+    spt_t carsSPT;
+    spt_t bikeSPT;
+    bool carsDestinationMajor;
+    bool bikeDestinationMajor;
+    if (!updateTree(before, &after, carStreets, argv[7], &carsSPT, &carsDestinationMajor)
+        || !updateTree(before, &after, bikeStreets, argv[8], &bikeSPT, &bikeDestinationMajor)) {
+        return -1;
+    }
+    if (!dumpTree(&after, carStreets, &carsSPT, carFile, carsDestinationMajor)
+        || !dumpTree(&after, bikeStreets, &bikeSPT, bikeFile, bikeDestinationMajor)) {
+        return -1;
+    }
+    stopMeasureTime(time);
+
+    time = startMeasureTime("Exporting to file");
+#ifdef SINGLE_FILE_EXPORT
+    exportSPT(carsSPT, bikeSPT, edited, &after, janFile);
+#else
+    nlohmann::json spts;
+    exportSPT(carsSPT, bikeSPT, edited, spts, &after);
+    save(janFile, &spts);
+#endif
+    stopMeasureTime(time);
+    return 0;
+}
+
 int main(int argc, char* argv[])
 {
-    if (argc < 4) {
-        std::cerr << "Usage PrecalculateSPT <map-in> <car-out> <bike-out> <jan-out>" << std::endl;
+    if (argc < 5) {
+        std::cerr << "Usage PrecalculateSPT <map-in> <car-out> <bike-out> <jan-out> optional <fw-backend> <layout> distances" << std::endl;
         std::cerr << "Function precalculates the spt" << std::endl;
+        std::cerr << "fw-backend is one of cuda, cpu or naive" << std::endl;
+        std::cerr << "layout is source (default) or destination, destination-major trees are faster to walk on large maps" << std::endl;
+        std::cerr << "Pass distances to store the length of every path with the trees, for travel distances without walking paths" << std::endl;
+        std::cerr << "Pass ch as fw-backend to write contraction hierarchies to car-out and bike-out instead, jan-out is not written" << std::endl;
+        std::cerr << "Pass disk as fw-backend for maps which don't fit into memory, the matrices are kept in car-out.fw and bike-out.fw" << std::endl;
+        std::cerr << "and a killed run resumes from them when it is started again" << std::endl;
+        std::cerr << "Pass update <diff-in> <car-base> <bike-base> <map-out> as fw-backend to update the trees of map-in for the roads" << std::endl;
+        std::cerr << "changed by the diff instead of computing them again, the changed map is written to map-out" << std::endl;
         return -1;
     }
 
@@ -32,6 +161,32 @@ int main(int argc, char* argv[])
     const char* carFile = argv[2];
     const char* bikeFile = argv[3];
     const char* janFile = argv[4];
+    FWBackend backend = DEFAULT_FW_BACKEND;
+    const bool contractionHierarchy = argc > 5 && std::string(argv[5]) == "ch";
+    const bool outOfCore = argc > 5 && std::string(argv[5]) == "disk";
+    const bool update = argc > 5 && std::string(argv[5]) == "update";
+    const bool destinationMajor = argc > 6 && std::string(argv[6]) == "destination";
+    const bool keepDistance = argc > 7 && !update && std::string(argv[7]) == "distances";
+
+    if (update && argc < 10) {
+        std::cerr << "Usage PrecalculateSPT <map-in> <car-out> <bike-out> <jan-out> update <diff-in> <car-base> <bike-base> <map-out>" << std::endl;
+        return -1;
+    }
+
+    if (argc > 6 && !update && !destinationMajor && std::string(argv[6]) != "source") {
+        std::cerr << "Unknown layout " << argv[6] << std::endl;
+        return -1;
+    }
+
+    if (argc > 7 && !update && !keepDistance) {
+        std::cerr << "Unknown option " << argv[7] << std::endl;
+        return -1;
+    }
+
+    if (argc > 5 && !contractionHierarchy && !outOfCore && !update && !parseFWBackend(argv[5], backend)) {
+        std::cerr << "Unknown Floyd Warshall backend " << argv[5] << std::endl;
+        return -1;
+    }
 
     world_t world;
     nlohmann::json import;
@@ -49,24 +204,63 @@ int main(int argc, char* argv[])
     importMap(&world, &import);
     stopMeasureTime(time);
 
+    if (update) {
+        return updateTrees(&world, &import, argv);
+    }
+
+    if (contractionHierarchy) {
+        time = startMeasureTime("building contraction hierarchies");
+        ch_t carsCH = buildContractionHierarchy(&world, {StreetTypes::Both, StreetTypes::OnlyCar});
+        ch_t bikeCH = buildContractionHierarchy(&world, {StreetTypes::Both, StreetTypes::OnlyBike});
+        stopMeasureTime(time);
+
+        if (!saveContractionHierarchy(&carsCH, carFile, &world) || !saveContractionHierarchy(&bikeCH, bikeFile, &world)) {
+            return -1;
+        }
+        return 0;
+    }
+
     time = startMeasureTime("calculating shortest path tree with floyd warshall");
 
-    spt_t carsSPT = calculateShortestPathTree(&world, { StreetTypes::Both, StreetTypes::OnlyCar});
+    const std::vector<StreetTypes> carStreets = {StreetTypes::Both, StreetTypes::OnlyCar};
+    const std::vector<StreetTypes> bikeStreets = {StreetTypes::Both, StreetTypes::OnlyBike};
+    const bool contractCars = !outOfCore && worthContracting(&world, carStreets);
+    const bool contractBikes = !outOfCore && worthContracting(&world, bikeStreets);
+    spt_t carsSPT;
+    spt_t bikeSPT;
+
+    const std::string carScratch = std::string(carFile) + ".fw";
+    const std::string bikeScratch = std::string(bikeFile) + ".fw";
+
+    // Both full trees come out of one run of Floyd Warshall, contracted trees have their own reduced graphs.
+    if (outOfCore) {
+        carsSPT = calculateShortestPathTreeOutOfCore(&world, carStreets, carScratch.c_str(), destinationMajor);
+        bikeSPT = calculateShortestPathTreeOutOfCore(&world, bikeStreets, bikeScratch.c_str(), destinationMajor);
+        if (carsSPT.array == nullptr || bikeSPT.array == nullptr) {
+            return -1;
+        }
+    }
+    else if (!contractCars && !contractBikes) {
+        calculateShortestPathTrees(&world, &carsSPT, &bikeSPT, backend, keepDistance);
+    }
+    else {
+        carsSPT = contractCars ? calculateContractedShortestPathTree(&world, carStreets, backend) : calculateShortestPathTree(&world, carStreets, backend, keepDistance);
+        bikeSPT = contractBikes ? calculateContractedShortestPathTree(&world, bikeStreets, backend) : calculateShortestPathTree(&world, bikeStreets, backend, keepDistance);
+    }
 #ifdef DDEBUG
     std::cout << std::endl << "Car Tree" << std::endl;
     printSPT(&carsSPT);
-#endif
-    binDumpSpt(&carsSPT, carFile);
-
-//#ifdef DDEBUG
-    std::cout << std::endl << std::endl << std::endl;
-//#endif
-    spt_t bikeSPT = calculateShortestPathTree(&world, { StreetTypes::Both, StreetTypes::OnlyBike });
-    binDumpSpt(&bikeSPT, bikeFile);
-#ifdef DDEBUG
     std::cout << std::endl << "Bike Tree" <<std::endl;
     printSPT(&bikeSPT);
 #endif
+    const bool dumped = dumpTree(&world, carStreets, &carsSPT, carFile, destinationMajor)
+        && dumpTree(&world, bikeStreets, &bikeSPT, bikeFile, destinationMajor);
+
+    // The scratch files are only needed to resume, once the trees are saved they can go.
+    if (outOfCore && dumped) {
+        std::remove(carScratch.c_str());
+        std::remove(bikeScratch.c_str());
+    }
 
     stopMeasureTime(time);
 
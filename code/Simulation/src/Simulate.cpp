@@ -14,27 +14,52 @@ At the end of the simulation, it exports the final state of the agents and the a
 #include <string>
 #include <chrono>
 #include <iomanip>
+#include <future>
 
 #include "actors.hpp"
 #include "routing.hpp"
 #include "update.hpp"
 #include "io.hpp"
 #include "utils.hpp"
+#include "ch.hpp"
 #include <cassert>
 
 #define STATUS_UPDATAE_INTERVAL 60
 #define USE_STUPID_INTERSECTIONS false
 #define SLURM_OUTPUT
 
+typedef std::pair<spt_t, spt_t> treePair_t; // Trees of the cars and of the bikes
+
+/*
+ * Starts computing the trees of the destinations of the actors which are still driving with the current travel times
+ * of the streets. The travel times are taken now, the trees are computed in the background while the simulation
+ * continues. Only the start, end and type of the streets are read in the background, which the simulation doesn't change.
+ */
+static std::future<treePair_t> startRerouting(const world_t* world)
+{
+    std::vector<double> weights = congestedStreetWeights(world);
+    std::vector<int> cars = activeDestinations(world, ActorTypes::Car);
+    std::vector<int> bikes = activeDestinations(world, ActorTypes::Bike);
+    return std::async(std::launch::async, [world, weights = std::move(weights), cars = std::move(cars), bikes = std::move(bikes)]() {
+        return treePair_t(calculateDestinationTrees(world, {StreetTypes::Both, StreetTypes::OnlyCar}, cars, &weights),
+                          calculateDestinationTrees(world, {StreetTypes::Both, StreetTypes::OnlyBike}, bikes, &weights));
+    });
+}
+
 int main(int argc, char* argv[])
 {
     assert(false && "Sanity checking with compiilers that asserts are still there with -O3"); // Comment for debugging
-    std::cout << "MAKE SURE THAT THE MAP MATCHES THE SPT" << std::endl;
 
     if (argc < 9) {
         std::cerr << "Intended for large scale simulations, no visualization is produced!" << std::endl;
         std::cerr << "Usage CSSMALG <mapIn> <carTreeIn> <bikeTreeIn> <agentsIn> <stats-log-interval> <agentsOut> <statsDirOut> <runtime> <timedelta>" << std::endl;
+        std::cerr << "Pass " << DEMAND_DRIVEN_TREE << " as carTreeIn and bikeTreeIn to compute the trees for the destinations of the agents only" << std::endl;
+        std::cerr << "carTreeIn and bikeTreeIn may also be contraction hierarchies written by PrecalculateSPT" << std::endl;
         std::cerr << "Make sure statsDirOut hsa a / as it's last character. AND DIRECTORY MUST EXIST" << std::endl;
+        std::cerr << "Optional <traffic-signals> (0 or 1) <reroute-interval>, with a reroute interval > 0 the routes are recomputed" << std::endl;
+        std::cerr << "with the current travel times every reroute-interval simulated seconds" << std::endl;
+        std::cerr << "Optional <stop-when-drained> (0 or 1), with 1 the simulation stops once all agents have arrived and runtime" << std::endl;
+        std::cerr << "only caps it, e.g. pass a week as runtime to run until all agents arrived" << std::endl;
         return -1;
     }
 
@@ -50,9 +75,11 @@ int main(int argc, char* argv[])
     const float deltaTime = std::atof(argv[9]);
     bool do_traffic_signals = false;
 
-    if (argc > 9) {
+    if (argc > 10) {
         do_traffic_signals = (*argv[10] == '1');
     }
+    const float rerouteInterval = (argc > 11) ? std::atof(argv[11]) : 0.0f;
+    const bool stopWhenDrained = (argc > 12) && (*argv[12] == '1');
 
     std::cout << "Simulaton is doing traffic signals? " << do_traffic_signals << std::endl;
 
@@ -72,16 +99,32 @@ int main(int argc, char* argv[])
     // Import the SPTs
     spt_t carsSPT;
     spt_t bikeSPT;
+    ch_t carsCH;
+    ch_t bikeCH;
+    const bool demandDriven = std::string(carTree) == DEMAND_DRIVEN_TREE && std::string(bikeTree) == DEMAND_DRIVEN_TREE;
+    const bool hierarchy = !demandDriven && isContractionHierarchyFile(carTree) && isContractionHierarchyFile(bikeTree);
 
-    start = startMeasureTime("importing shortest path trees");
-    // Don't continue if loading fails.
-    if (!binLoadTree(&carsSPT, carTree, &world)) {
-        return -1;
+    if (hierarchy) {
+        start = startMeasureTime("importing contraction hierarchies");
+        if (!loadContractionHierarchy(&carsCH, carTree, &world)) {
+            return -1;
+        }
+        if (!loadContractionHierarchy(&bikeCH, bikeTree, &world)) {
+            return -1;
+        }
+        stopMeasureTime(start);
     }
-    if (!binLoadTree(&bikeSPT, bikeTree, &world)) {
-        return -1;
+    else if (!demandDriven) {
+        start = startMeasureTime("importing shortest path trees");
+        // Don't continue if loading fails.
+        if (!binLoadTree(&carsSPT, carTree, &world, {StreetTypes::Both, StreetTypes::OnlyCar})) {
+            return -1;
+        }
+        if (!binLoadTree(&bikeSPT, bikeTree, &world, {StreetTypes::Both, StreetTypes::OnlyBike})) {
+            return -1;
+        }
+        stopMeasureTime(start);
     }
-    stopMeasureTime(start);
 
 #ifdef DDEBUG
     for (auto iter : world.string_to_int) {
@@ -96,13 +139,6 @@ int main(int argc, char* argv[])
     }
 #endif
 
-    // DEBUGGING PRINT
-#ifdef DDBEUG
-    std::cout << "Car Tree" << std::endl;
-    printSPT(&carsSPT);
-    std::cout << "Bike Tree" <<std::endl;
-    printSPT(&bikeSPT);
-#endif
     // Scope so json gets destroyed.
     // Import the agents.
     {
@@ -111,13 +147,41 @@ int main(int argc, char* argv[])
         if (!loadFile(agentsIn, &agents)) {
             return -1;
         }
-        importAgents(&world, &agents, &carsSPT, &bikeSPT);
+        stopMeasureTime(start);
+
+        // Only the destinations of the agents are needed, so only their trees are computed.
+        if (demandDriven) {
+            start = startMeasureTime("calculating demand driven shortest path trees");
+            carsSPT = calculateDestinationTrees(&world, {StreetTypes::Both, StreetTypes::OnlyCar}, agentDestinations(&world, &agents, "cars"));
+            bikeSPT = calculateDestinationTrees(&world, {StreetTypes::Both, StreetTypes::OnlyBike}, agentDestinations(&world, &agents, "bikes"));
+            stopMeasureTime(start);
+        }
+
+        // DEBUGGING PRINT
+#ifdef DDBEUG
+        std::cout << "Car Tree" << std::endl;
+        printSPT(&carsSPT);
+        std::cout << "Bike Tree" <<std::endl;
+        printSPT(&bikeSPT);
+#endif
+        start = startMeasureTime("routing actors");
+        if (hierarchy) {
+            importAgents(&world, &agents, &carsCH, &bikeCH);
+        }
+        else {
+            importAgents(&world, &agents, &carsSPT, &bikeSPT);
+        }
         stopMeasureTime(start);
     }
 
     // Export the world.
     nlohmann::json output;
-    output = exportWorld(&world, runtime, deltaTime, &import["peripherals"]["map"]);
+    if (hierarchy) {
+        output = exportWorld(&world, runtime, deltaTime, &import["peripherals"]["map"]);
+    }
+    else {
+        output = exportWorld(&world, runtime, deltaTime, &import["peripherals"]["map"], &carsSPT, &bikeSPT);
+    }
 
     // Sort the Cars in the intersections
     start = startMeasureTime("sorting actors in intersections");
@@ -145,43 +209,92 @@ int main(int argc, char* argv[])
     float lastStatusTime = runtime;
     float lastStatsTime = runtime;
     float lastDeadLockTime = runtime;
+    float lastRerouteTime = runtime;
+    const bool reroute = rerouteInterval > 0.0f && !hierarchy;
+    if (rerouteInterval > 0.0f && hierarchy) {
+        std::cerr << "Rerouting needs shortest path trees, the routes of contraction hierarchies are kept" << std::endl;
+    }
+    std::future<treePair_t> rerouting;
+    treePair_t rerouted[2] = {}; // The trees of the last rerouting the actors use and the ones which replace them
+    int current = 0;
 //    bool emptyness = false;
 //    bool current_emptyness = false;
     std::cout << std::endl;
-    while (maxTime > 0.0f) {
-        updateIntersections(&world, deltaTime, USE_STUPID_INTERSECTIONS, runtime - maxTime);
-        lastDeadLockTime = (updateStreets(&world, deltaTime)) ? maxTime : lastDeadLockTime;
-
-        // Longer than 20s so every road should havruntime - maxTimee had green once
-        if  (lastDeadLockTime - maxTime > 15.0f) {
-            std::cerr << "Deadlock detected at Time " << maxTime << std::endl;
-            resolveDeadLocks(&world, runtime - maxTime);
-            lastDeadLockTime = maxTime;
-        }
-        maxTime -= deltaTime;
 
-        // Status messsage to tell me how far the simulation  has come along
-        if (lastStatusTime - maxTime >= STATUS_UPDATAE_INTERVAL) {
-            lastStatusTime = maxTime;
+    // One team of threads runs all steps, so no team is started per step. The bookkeeping between the steps runs on one
+    // thread, the barrier at the end of the single block keeps the others from starting the next step before it is done.
+    std::vector<WorkChunk> chunks;
+    int actorMoved = 0;
+    bool running = maxTime > 0.0f;
+    #pragma omp parallel default(none) shared(world, output, chunks, actorMoved, running, maxTime, runtime, deltaTime, lastDeadLockTime, \
+        rerouting, rerouted, current, reroute, lastRerouteTime, rerouteInterval, lastStatusTime, lastStatsTime, statsLogInterval, \
+        statsDirOut, stopWhenDrained, std::cout, std::cerr)
+    while (running) {
+        updateStepInTeam(&world, deltaTime, USE_STUPID_INTERSECTIONS, runtime - maxTime, chunks, actorMoved);
+
+        #pragma omp single
+        {
+            lastDeadLockTime = (actorMoved || emptynessOfStreets(&world)) ? maxTime : lastDeadLockTime;
+            actorMoved = 0;
+
+            // Longer than 20s so every road should havruntime - maxTimee had green once
+            if  (lastDeadLockTime - maxTime > 15.0f) {
+                std::cerr << "Deadlock detected at Time " << maxTime << std::endl;
+                resolveDeadLocks(&world, runtime - maxTime);
+                lastDeadLockTime = maxTime;
+            }
+            maxTime -= deltaTime;
+
+            // Switch the actors to the trees of the last rerouting once they are ready, the simulation doesn't wait for them.
+            if (rerouting.valid() && rerouting.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                rerouted[1 - current] = rerouting.get();
+                rerouteActors(&world, &rerouted[1 - current].first, &rerouted[1 - current].second);
+                freeSPT(&rerouted[current].first);
+                freeSPT(&rerouted[current].second);
+                current = 1 - current;
+            }
+            else if (reroute && !rerouting.valid() && lastRerouteTime - maxTime >= rerouteInterval) {
+                lastRerouteTime = maxTime;
+                rerouting = startRerouting(&world);
+            }
+
+            // Status messsage to tell me how far the simulation  has come along
+            if (lastStatusTime - maxTime >= STATUS_UPDATAE_INTERVAL) {
+                lastStatusTime = maxTime;
 #ifdef SLURM_OUTPUT
-            std::cout << "Time to simulate:  " << maxTime << " remaining seconds" << std::endl;
+                std::cout << "Time to simulate:  " << maxTime << " remaining seconds" << std::endl;
 #else
-            std::cout << "\rTime to simulate:  " << maxTime << " remaining seconds" << std::flush;
+                std::cout << "\rTime to simulate:  " << maxTime << " remaining seconds" << std::flush;
 #endif
-        }
+            }
 #ifdef ADD_INCREMENTS
-        addFrame(&world, &output, false);
+            addFrame(&world, &output, false);
 #endif
-        // Dump stats to file if time has passed
-        if (lastStatsTime - maxTime >= statsLogInterval) {
-            lastStatsTime = maxTime;
-            std::string statsFile = statsDirOut + std::to_string(runtime - maxTime) + ".json";
-            nlohmann::json stats;
-            jsonDumpStats(statsLogInterval, &stats, &world, false);
-            save(statsFile, &stats);
-        }
+            // Dump stats to file if time has passed
+            if (lastStatsTime - maxTime >= statsLogInterval) {
+                lastStatsTime = maxTime;
+                std::string statsFile = statsDirOut + std::to_string(runtime - maxTime) + ".json";
+                nlohmann::json stats;
+                jsonDumpStats(statsLogInterval, &stats, &world, false);
+                save(statsFile, &stats);
+            }
 
+            if (stopWhenDrained && drained(&world)) {
+                std::cout << "All " << world.arrivedActors << " agents arrived after " << runtime - maxTime << " seconds" << std::endl;
+                running = false;
+            }
+            running = running && maxTime > 0.0f;
+        }
+    }
+    if (stopWhenDrained && !drained(&world)) {
+        std::cout << "Runtime ended with " << world.waitingActors << " agents waiting and " << world.drivingActors << " driving" << std::endl;
     }
+    if (rerouting.valid()) {
+        treePair_t trees = rerouting.get();
+        freeSPT(&trees.first);
+        freeSPT(&trees.second);
+    }
+
     // Committing final state of simulation to output, required for the start and stop time.
     std::cout << std::endl;
     addFrame(&world, &output, true);
@@ -74,8 +74,7 @@ int main(int argc, char* argv[])
     }
     else {
         start = startMeasureTime("calculating shortest path tree with floyd warshall");
-        carsSPT = calculateShortestPathTree(&world, {StreetTypes::Both, StreetTypes::OnlyCar});
-        bikeSPT = calculateShortestPathTree(&world, {StreetTypes::Both, StreetTypes::OnlyBike});
+        calculateShortestPathTrees(&world, &carsSPT, &bikeSPT, DEFAULT_FW_BACKEND, true);
         stopMeasureTime(start);
     }
 #ifdef DDEBUG
@@ -96,7 +95,7 @@ int main(int argc, char* argv[])
         importAgents(&world, &agents, &carsSPT, &bikeSPT);
     }
     else {
-        world.actors = std::vector<Actor*>(randomCars + randomBikes);
+        allocateActors(&world, randomCars + randomBikes);
         createRandomActors(&world, &carsSPT, ActorTypes::Car, 30, 120, 0, randomCars, 4.5f, static_cast<int>(runtime * 0.5));
         createRandomActors(&world, &bikeSPT, ActorTypes::Bike, 10, 25, randomCars, randomBikes, 1.5f, static_cast<int>(runtime * 0.5));
     }
@@ -105,10 +104,10 @@ int main(int argc, char* argv[])
 
     nlohmann::json output;
     if (hasPrecompute(&import)) {
-        output = exportWorld(&world, runtime, deltaTime, &import["world"]["peripherals"]["map"]);
+        output = exportWorld(&world, runtime, deltaTime, &import["world"]["peripherals"]["map"], &carsSPT, &bikeSPT);
     }
     else {
-        output = exportWorld(&world, runtime, deltaTime, &import["peripherals"]["map"]);
+        output = exportWorld(&world, runtime, deltaTime, &import["peripherals"]["map"], &carsSPT, &bikeSPT);
     }
 
     start = startMeasureTime("sorting actors in intersections");
@@ -132,8 +131,7 @@ int main(int argc, char* argv[])
     float lastStatusTime = runtime;
     float lastDeadLockTime = runtime;
     while (maxTime > 0.0f) {
-        updateIntersections(&world, deltaTime, stupidIntersections, runtime - maxTime);
-        lastDeadLockTime = (updateStreets(&world, deltaTime)) ? maxTime : lastDeadLockTime;
+        lastDeadLockTime = (updateStep(&world, deltaTime, stupidIntersections, runtime - maxTime)) ? maxTime : lastDeadLockTime;
 
         // Longer than 20s so every road should have had green once
         if  (lastDeadLockTime - maxTime > 15.0f) {
@@ -0,0 +1,475 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <queue>
+#include <functional>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <array>
+
+#include "ch.hpp"
+#include "routing.hpp"
+#include "io.hpp"
+
+typedef std::pair<double, int> QueueEntry;
+typedef std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<>> MinQueue;
+
+// Edge of the graph while it is being contracted, node is the target of outbound and the source of inbound edges.
+typedef struct DynamicEdge {
+    int node;
+    int middle;
+    double weight;
+} dynamicEdge_t;
+
+typedef struct ContractionGraph {
+    std::vector<std::vector<DynamicEdge>> out;
+    std::vector<std::vector<DynamicEdge>> in;
+    std::vector<bool> contracted;
+    std::vector<int> deletedNeighbours;
+} contractionGraph_t;
+
+// Distances of the witness search, only the touched entries are reset between searches.
+typedef struct WitnessSearch {
+    std::vector<double> distance;
+    std::vector<int> touched;
+} witnessSearch_t;
+
+// Workspace of a query, one per thread so queries can run in parallel.
+typedef struct CHQuery {
+    std::vector<double> distance[2];
+    std::vector<int> parent[2];
+    std::vector<int> middle[2];
+    std::vector<int> touched;
+} chQuery_t;
+
+/*
+ * Adds an edge or lowers the weight of the existing one, so there is at most one edge between two intersections.
+ */
+static void addEdge(std::vector<DynamicEdge>& edges, const int node, const int middle, const double weight)
+{
+    for (auto& edge : edges) {
+        if (edge.node == node) {
+            if (weight < edge.weight) {
+                edge.weight = weight;
+                edge.middle = middle;
+            }
+            return;
+        }
+    }
+    edges.push_back({node, middle, weight});
+}
+
+/*
+ * Dijkstra from source on the not yet contracted intersections without skip. Stops once maxDistance is reached or
+ * CH_WITNESS_SETTLE_LIMIT intersections are settled. If it stops early, it may miss a witness, which only results in
+ * an unnecessary shortcut.
+ */
+static void witnessSearch(const ContractionGraph& graph, WitnessSearch& ws, const int source, const int skip, const double maxDistance)
+{
+    for (const int v : ws.touched) {
+        ws.distance[v] = 1e30;
+    }
+    ws.touched.clear();
+
+    MinQueue queue;
+    ws.distance[source] = 0.0;
+    ws.touched.push_back(source);
+    queue.emplace(0.0, source);
+    int settled = 0;
+
+    while (!queue.empty()) {
+        const auto [d, v] = queue.top();
+        queue.pop();
+        if (d > ws.distance[v]) {
+            continue;
+        }
+        if (d > maxDistance || ++settled > CH_WITNESS_SETTLE_LIMIT) {
+            break;
+        }
+
+        for (const auto& edge : graph.out[v]) {
+            if (graph.contracted[edge.node] || edge.node == skip) {
+                continue;
+            }
+            const double newDistance = d + edge.weight;
+            if (newDistance < ws.distance[edge.node]) {
+                if (ws.distance[edge.node] == 1e30) {
+                    ws.touched.push_back(edge.node);
+                }
+                ws.distance[edge.node] = newDistance;
+                queue.emplace(newDistance, edge.node);
+            }
+        }
+    }
+}
+
+/*
+ * Contracts v, i.e. adds a shortcut u -> w for every pair of neighbours where u -> v -> w is the only shortest path.
+ * With simulate set, the shortcuts are only counted. Returns the number of shortcuts.
+ */
+static int contractIntersection(ContractionGraph& graph, WitnessSearch& ws, const int v, const bool simulate)
+{
+    int shortcuts = 0;
+    double maxOut = 0.0;
+    for (const auto& out : graph.out[v]) {
+        if (!graph.contracted[out.node]) {
+            maxOut = std::max(maxOut, out.weight);
+        }
+    }
+
+    for (const auto& in : graph.in[v]) {
+        if (graph.contracted[in.node]) {
+            continue;
+        }
+        witnessSearch(graph, ws, in.node, v, in.weight + maxOut);
+
+        for (const auto& out : graph.out[v]) {
+            if (graph.contracted[out.node] || out.node == in.node) {
+                continue;
+            }
+            const double via = in.weight + out.weight;
+            if (ws.distance[out.node] <= via) {
+                continue;
+            }
+            shortcuts++;
+            if (!simulate) {
+                addEdge(graph.out[in.node], out.node, v, via);
+                addEdge(graph.in[out.node], in.node, v, via);
+            }
+        }
+    }
+    return shortcuts;
+}
+
+/*
+ * Importance of an intersection, the least important one is contracted first. The edge difference keeps the number of
+ * shortcuts low, the deleted neighbours spread the contraction uniformly over the map.
+ */
+static int contractionPriority(ContractionGraph& graph, WitnessSearch& ws, const int v)
+{
+    int removed = 0;
+    for (const auto& edge : graph.in[v]) {
+        removed += !graph.contracted[edge.node];
+    }
+    for (const auto& edge : graph.out[v]) {
+        removed += !graph.contracted[edge.node];
+    }
+    return contractIntersection(graph, ws, v, true) - removed + graph.deletedNeighbours[v];
+}
+
+ch_t buildContractionHierarchy(const world_t* world, const std::vector<StreetTypes>& include)
+{
+    const int V = static_cast<int>(world->intersections.size());
+    ContractionGraph graph;
+    graph.out = std::vector<std::vector<DynamicEdge>>(V);
+    graph.in = std::vector<std::vector<DynamicEdge>>(V);
+    graph.contracted = std::vector<bool>(V, false);
+    graph.deletedNeighbours = std::vector<int>(V, 0);
+
+    for (const auto& street : world->streets) {
+        if (street.start == street.end || std::find(include.begin(), include.end(), street.type) == include.end()) {
+            continue;
+        }
+        addEdge(graph.out[street.start], street.end, -1, streetWeight(street));
+        addEdge(graph.in[street.end], street.start, -1, streetWeight(street));
+    }
+
+    WitnessSearch ws;
+    ws.distance = std::vector<double>(V, 1e30);
+
+    MinQueue queue;
+    for (int v = 0; v < V; v++) {
+        queue.emplace(contractionPriority(graph, ws, v), v);
+    }
+
+    ch_t ch;
+    ch.size = V;
+    ch.rank = std::vector<int>(V, -1);
+    int order = 0;
+
+    // Lazy updates: the priority of the top is recomputed, if it got worse it is put back into the queue.
+    while (!queue.empty()) {
+        const int v = queue.top().second;
+        queue.pop();
+        if (graph.contracted[v]) {
+            continue;
+        }
+        const int priority = contractionPriority(graph, ws, v);
+        if (!queue.empty() && priority > queue.top().first) {
+            queue.emplace(priority, v);
+            continue;
+        }
+
+        contractIntersection(graph, ws, v, false);
+        graph.contracted[v] = true;
+        ch.rank[v] = order++;
+        for (const auto& edge : graph.in[v]) {
+            graph.deletedNeighbours[edge.node]++;
+        }
+        for (const auto& edge : graph.out[v]) {
+            graph.deletedNeighbours[edge.node]++;
+        }
+
+        if (order % 1000 == 0 || order == V) {
+#ifdef SLURM_OUTPUT
+            std::cout << "Contracted " << order << " of " << V << std::endl;
+#else
+            std::cout << "\rContracted " << order << " of " << V << std::flush;
+#endif
+        }
+    }
+    std::cout << std::endl;
+
+    // Only keep the edges going upwards in the hierarchy.
+    ch.forwardOffset = std::vector<int>(V + 1, 0);
+    ch.backwardOffset = std::vector<int>(V + 1, 0);
+    for (int v = 0; v < V; v++) {
+        for (const auto& edge : graph.out[v]) {
+            if (ch.rank[edge.node] > ch.rank[v]) {
+                ch.forward.push_back({edge.node, edge.middle, edge.weight});
+            }
+        }
+        ch.forwardOffset[v + 1] = static_cast<int>(ch.forward.size());
+
+        for (const auto& edge : graph.in[v]) {
+            if (ch.rank[edge.node] > ch.rank[v]) {
+                ch.backward.push_back({edge.node, edge.middle, edge.weight});
+            }
+        }
+        ch.backwardOffset[v + 1] = static_cast<int>(ch.backward.size());
+    }
+
+    std::cout << "Contraction hierarchy with " << ch.forward.size() + ch.backward.size() << " edges for "
+              << world->streets.size() << " streets" << std::endl;
+    return ch;
+}
+
+/*
+ * Middle of the edge at -> target in the given direction of the hierarchy.
+ */
+static int edgeMiddle(const std::vector<chEdge_t>& edges, const std::vector<int>& offset, const int at, const int target)
+{
+    for (int i = offset[at]; i < offset[at + 1]; i++) {
+        if (edges[i].target == target) {
+            return edges[i].middle;
+        }
+    }
+    assert(false && "Edge of a shortcut is missing in the hierarchy");
+    return -1;
+}
+
+/*
+ * Replaces the (shortcut) edge from -> to with the intersections of the streets it consists of, excluding from.
+ */
+static void unpackEdge(const ch_t* ch, const int from, const int to, const int middle, Path& path)
+{
+    std::vector<std::array<int, 3>> stack = {{from, to, middle}};
+
+    while (!stack.empty()) {
+        const auto [u, w, m] = stack.back();
+        stack.pop_back();
+        if (m == -1) {
+            path.push(w);
+            continue;
+        }
+
+        // The edge u -> m goes down to m, so it is stored backward at m. The edge m -> w goes up from m.
+        // Pushed in reverse order, so u -> m is unpacked first.
+        stack.push_back({m, w, edgeMiddle(ch->forward, ch->forwardOffset, m, w)});
+        stack.push_back({u, m, edgeMiddle(ch->backward, ch->backwardOffset, m, u)});
+    }
+}
+
+Path retrievePath(const ch_t* ch, const int &start, const int &end)
+{
+    if (start < 0 || end < 0 || start == end) {
+        return {};
+    }
+
+    static thread_local CHQuery query;
+    if (query.touched.empty() && query.distance[0].size() != static_cast<std::size_t>(ch->size)) {
+        for (int dir = 0; dir < 2; dir++) {
+            query.distance[dir] = std::vector<double>(ch->size, 1e30);
+            query.parent[dir] = std::vector<int>(ch->size, -1);
+            query.middle[dir] = std::vector<int>(ch->size, -1);
+        }
+    }
+
+    // Bidirectional Dijkstra, the forward search from start and the backward search from end both only go upwards.
+    MinQueue queue[2];
+    query.distance[0][start] = 0.0;
+    query.distance[1][end] = 0.0;
+    query.touched.push_back(start);
+    query.touched.push_back(end);
+    queue[0].emplace(0.0, start);
+    queue[1].emplace(0.0, end);
+
+    double best = 1e30;
+    int meeting = -1;
+
+    while (!queue[0].empty() || !queue[1].empty()) {
+        for (int dir = 0; dir < 2; dir++) {
+            if (queue[dir].empty()) {
+                continue;
+            }
+            const auto [d, v] = queue[dir].top();
+            queue[dir].pop();
+
+            // Nothing in this direction can lead to a shorter path anymore.
+            if (d >= best) {
+                queue[dir] = MinQueue();
+                continue;
+            }
+            if (d > query.distance[dir][v]) {
+                continue;
+            }
+
+            if (d + query.distance[1 - dir][v] < best) {
+                best = d + query.distance[1 - dir][v];
+                meeting = v;
+            }
+
+            const std::vector<chEdge_t>& edges = (dir == 0) ? ch->forward : ch->backward;
+            const std::vector<int>& offset = (dir == 0) ? ch->forwardOffset : ch->backwardOffset;
+            for (int i = offset[v]; i < offset[v + 1]; i++) {
+                const chEdge_t& edge = edges[i];
+                const double newDistance = d + edge.weight;
+                if (newDistance < query.distance[dir][edge.target]) {
+                    if (query.distance[0][edge.target] == 1e30 && query.distance[1][edge.target] == 1e30) {
+                        query.touched.push_back(edge.target);
+                    }
+                    query.distance[dir][edge.target] = newDistance;
+                    query.parent[dir][edge.target] = v;
+                    query.middle[dir][edge.target] = edge.middle;
+                    queue[dir].emplace(newDistance, edge.target);
+                }
+            }
+        }
+    }
+
+    Path p;
+    if (meeting != -1) {
+        // Edges from start up to the meeting intersection and from there down to end.
+        std::vector<std::array<int, 3>> edges;
+        for (int v = meeting; v != start; v = query.parent[0][v]) {
+            edges.push_back({query.parent[0][v], v, query.middle[0][v]});
+        }
+        std::reverse(edges.begin(), edges.end());
+        for (int v = meeting; v != end; v = query.parent[1][v]) {
+            edges.push_back({v, query.parent[1][v], query.middle[1][v]});
+        }
+
+        for (const auto& [from, to, middle] : edges) {
+            unpackEdge(ch, from, to, middle, p);
+        }
+    }
+
+    // Reset the workspace for the next query.
+    for (const int v : query.touched) {
+        for (int dir = 0; dir < 2; dir++) {
+            query.distance[dir][v] = 1e30;
+            query.parent[dir][v] = -1;
+            query.middle[dir][v] = -1;
+        }
+    }
+    query.touched.clear();
+    return p;
+}
+
+std::vector<Path> retrievePaths(const ch_t* ch, const std::vector<std::pair<int, int>>& queries)
+{
+    const int n = static_cast<int>(queries.size());
+    std::vector<Path> paths(n);
+
+    #pragma omp parallel for schedule(dynamic, 64) default(none) shared(ch, queries, paths, n)
+    for (int q = 0; q < n; q++) {
+        paths[q] = retrievePath(ch, queries[q].first, queries[q].second);
+    }
+    return paths;
+}
+
+template <typename T>
+static void writeVector(std::ofstream& f, const std::vector<T>& data)
+{
+    f.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size() * sizeof(T)));
+}
+
+template <typename T>
+static void readVector(std::ifstream& f, std::vector<T>& data, const std::size_t size)
+{
+    data = std::vector<T>(size);
+    f.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(size * sizeof(T)));
+}
+
+bool saveContractionHierarchy(const ch_t* ch, const char* file_name, const world_t* world)
+{
+    std::ofstream f(file_name, std::ios::binary);
+    if (!f.is_open()) {
+        std::cerr << "Failed to save to " << file_name << std::endl;
+        return false;
+    }
+
+    const int64_t sizes[3] = {ch->size, static_cast<int64_t>(ch->forward.size()), static_cast<int64_t>(ch->backward.size())};
+    f.write(CH_FILE_MAGIC, 8);
+    f.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+    const uint64_t fingerprint = mapFingerprint(world);
+    f.write(reinterpret_cast<const char*>(&fingerprint), sizeof(fingerprint));
+    writeVector(f, ch->rank);
+    writeVector(f, ch->forwardOffset);
+    writeVector(f, ch->forward);
+    writeVector(f, ch->backwardOffset);
+    writeVector(f, ch->backward);
+    f.close();
+    return true;
+}
+
+bool loadContractionHierarchy(ch_t* ch, const char* file_name, const world_t* world)
+{
+    std::ifstream f(file_name, std::ios::binary);
+    if (!f.is_open()) {
+        std::cerr << "Failed to load " << file_name << std::endl;
+        return false;
+    }
+
+    char magic[8];
+    int64_t sizes[3];
+    uint64_t fingerprint;
+    f.read(magic, 8);
+    f.read(reinterpret_cast<char*>(sizes), sizeof(sizes));
+    f.read(reinterpret_cast<char*>(&fingerprint), sizeof(fingerprint));
+    if (!f || std::memcmp(magic, CH_FILE_MAGIC, 8) != 0) {
+        std::cerr << file_name << " is not a contraction hierarchy" << std::endl;
+        return false;
+    }
+    if (sizes[0] != static_cast<int64_t>(world->intersections.size())) {
+        std::cerr << "Contraction hierarchy " << file_name << " has " << sizes[0] << " intersections, the map has "
+                  << world->intersections.size() << std::endl;
+        return false;
+    }
+    if (fingerprint != mapFingerprint(world)) {
+        std::cerr << "Contraction hierarchy " << file_name << " was built for a different map" << std::endl;
+        return false;
+    }
+
+    ch->size = static_cast<int>(sizes[0]);
+    readVector(f, ch->rank, ch->size);
+    readVector(f, ch->forwardOffset, ch->size + 1);
+    readVector(f, ch->forward, sizes[1]);
+    readVector(f, ch->backwardOffset, ch->size + 1);
+    readVector(f, ch->backward, sizes[2]);
+
+    if (!f) {
+        std::cerr << "Contraction hierarchy " << file_name << " is truncated" << std::endl;
+        return false;
+    }
+    std::cout << "Loaded contraction hierarchy with " << sizes[1] + sizes[2] << " edges" << std::endl;
+    return true;
+}
+
+bool isContractionHierarchyFile(const char* file_name)
+{
+    std::ifstream f(file_name, std::ios::binary);
+    char magic[8];
+    return f.read(magic, 8) && std::memcmp(magic, CH_FILE_MAGIC, 8) == 0;
+}
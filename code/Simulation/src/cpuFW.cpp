@@ -0,0 +1,436 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cpuFW.hpp"
+#include "fnv1a.hpp"
+
+void FloydWarshalNaive(double* dis, int* next, int V)
+{
+    const std::size_t n = V;
+    double newDistance;
+
+    std::cout << std::endl;
+    for (std::size_t k = 0; k < n; k++) {
+#ifdef SLURM_OUTPUT
+        std::cout << "k: " << (k + 1) << " of " << V << std::endl;
+#else
+        std::cout << "\rk: " << (k + 1) << " of " << V << std::flush;
+#endif
+        for (std::size_t i = 0; i < n; i++) {
+            for (std::size_t j = 0; j < n; j++) {
+                newDistance = dis[i * n + k] + dis[k * n + j];
+                if (newDistance < dis[i * n + j]) {
+                    dis[i * n + j] = newDistance;
+                    next[i * n + j] = next[i * n + k];
+                }
+            }
+        }
+    }
+    std::cout << std::endl;
+}
+
+/*
+ * Relaxes the tile [i0, i1) x [j0, j1) over all intermediate vertices in [k0, k1).
+ * The inner loop is branch free, so it is vectorized. Reading row k while writing row i is fine even if the two rows
+ * are the same, since dis[k][k] is 0 and a row can never improve itself.
+ */
+static inline void relaxTile(double* dis, int* next, const std::size_t n,
+                             const std::size_t i0, const std::size_t i1,
+                             const std::size_t j0, const std::size_t j1,
+                             const std::size_t k0, const std::size_t k1)
+{
+    for (std::size_t k = k0; k < k1; k++) {
+        const double* disK = dis + k * n;
+
+        for (std::size_t i = i0; i < i1; i++) {
+            double* disI = dis + i * n;
+            int* nextI = next + i * n;
+            const double disIK = disI[k];
+            const int nextIK = nextI[k];
+
+            #pragma omp simd
+            for (std::size_t j = j0; j < j1; j++) {
+                const double newDistance = disIK + disK[j];
+                const double oldDistance = disI[j];
+                const int oldNext = nextI[j];
+                const bool shorter = newDistance < oldDistance;
+                disI[j] = shorter ? newDistance : oldDistance;
+                nextI[j] = shorter ? nextIK : oldNext;
+            }
+        }
+    }
+}
+
+void FloydWarshalBlocked(double* dis, int* next, int V)
+{
+    const std::size_t n = V;
+    const std::size_t B = FW_BLOCK_SIZE;
+    const std::size_t blocks = (n + B - 1) / B;
+
+    std::cout << std::endl;
+    for (std::size_t kb = 0; kb < blocks; kb++) {
+#ifdef SLURM_OUTPUT
+        std::cout << "k-block: " << (kb + 1) << " of " << blocks << std::endl;
+#else
+        std::cout << "\rk-block: " << (kb + 1) << " of " << blocks << std::flush;
+#endif
+        const std::size_t k0 = kb * B;
+        const std::size_t k1 = std::min(k0 + B, n);
+
+        // Phase 1: The diagonal tile only depends on itself.
+        relaxTile(dis, next, n, k0, k1, k0, k1, k0, k1);
+
+        // Phase 2: Tiles in row kb and column kb only depend on themselves and on the diagonal tile.
+        #pragma omp parallel for schedule(dynamic) default(none) shared(dis, next, n, B, blocks, kb, k0, k1)
+        for (std::size_t b = 0; b < 2 * blocks; b++) {
+            const std::size_t other = b % blocks;
+            if (other == kb) {
+                continue;
+            }
+            const std::size_t o0 = other * B;
+            const std::size_t o1 = std::min(o0 + B, n);
+            if (b < blocks) {
+                relaxTile(dis, next, n, k0, k1, o0, o1, k0, k1);
+            }
+            else {
+                relaxTile(dis, next, n, o0, o1, k0, k1, k0, k1);
+            }
+        }
+
+        // Phase 3: All remaining tiles only depend on their row and column tile computed in phase 2.
+        #pragma omp parallel for collapse(2) schedule(dynamic) default(none) shared(dis, next, n, B, blocks, kb, k0, k1)
+        for (std::size_t ib = 0; ib < blocks; ib++) {
+            for (std::size_t jb = 0; jb < blocks; jb++) {
+                if (ib == kb || jb == kb) {
+                    continue;
+                }
+                const std::size_t i0 = ib * B;
+                const std::size_t j0 = jb * B;
+                relaxTile(dis, next, n, i0, std::min(i0 + B, n), j0, std::min(j0 + B, n), k0, k1);
+            }
+        }
+    }
+    std::cout << std::endl;
+}
+
+/*
+ * Same as relaxTile for two graphs with interleaved rows, entry (i, j) of graph l is at (2 * i + l) * n + j. Row i of
+ * both graphs is relaxed with the same row k before moving on, so both rows are streamed through the cache together.
+ */
+static inline void relaxTilePair(double* dis, int* next, const std::size_t n,
+                                 const std::size_t i0, const std::size_t i1,
+                                 const std::size_t j0, const std::size_t j1,
+                                 const std::size_t k0, const std::size_t k1)
+{
+    for (std::size_t k = k0; k < k1; k++) {
+        for (std::size_t i = i0; i < i1; i++) {
+            for (std::size_t lane = 0; lane < 2; lane++) {
+                const double* disK = dis + (2 * k + lane) * n;
+                double* disI = dis + (2 * i + lane) * n;
+                int* nextI = next + (2 * i + lane) * n;
+                const double disIK = disI[k];
+                const int nextIK = nextI[k];
+
+                #pragma omp simd
+                for (std::size_t j = j0; j < j1; j++) {
+                    const double newDistance = disIK + disK[j];
+                    const double oldDistance = disI[j];
+                    const int oldNext = nextI[j];
+                    const bool shorter = newDistance < oldDistance;
+                    disI[j] = shorter ? newDistance : oldDistance;
+                    nextI[j] = shorter ? nextIK : oldNext;
+                }
+            }
+        }
+    }
+}
+
+void FloydWarshalBlockedPair(double* dis, int* next, int V)
+{
+    const std::size_t n = V;
+    const std::size_t B = FW_BLOCK_SIZE;
+    const std::size_t blocks = (n + B - 1) / B;
+
+    std::cout << std::endl;
+    for (std::size_t kb = 0; kb < blocks; kb++) {
+#ifdef SLURM_OUTPUT
+        std::cout << "k-block: " << (kb + 1) << " of " << blocks << std::endl;
+#else
+        std::cout << "\rk-block: " << (kb + 1) << " of " << blocks << std::flush;
+#endif
+        const std::size_t k0 = kb * B;
+        const std::size_t k1 = std::min(k0 + B, n);
+
+        relaxTilePair(dis, next, n, k0, k1, k0, k1, k0, k1);
+
+        #pragma omp parallel for schedule(dynamic) default(none) shared(dis, next, n, B, blocks, kb, k0, k1)
+        for (std::size_t b = 0; b < 2 * blocks; b++) {
+            const std::size_t other = b % blocks;
+            if (other == kb) {
+                continue;
+            }
+            const std::size_t o0 = other * B;
+            const std::size_t o1 = std::min(o0 + B, n);
+            if (b < blocks) {
+                relaxTilePair(dis, next, n, k0, k1, o0, o1, k0, k1);
+            }
+            else {
+                relaxTilePair(dis, next, n, o0, o1, k0, k1, k0, k1);
+            }
+        }
+
+        #pragma omp parallel for collapse(2) schedule(dynamic) default(none) shared(dis, next, n, B, blocks, kb, k0, k1)
+        for (std::size_t ib = 0; ib < blocks; ib++) {
+            for (std::size_t jb = 0; jb < blocks; jb++) {
+                if (ib == kb || jb == kb) {
+                    continue;
+                }
+                const std::size_t i0 = ib * B;
+                const std::size_t j0 = jb * B;
+                relaxTilePair(dis, next, n, i0, std::min(i0 + B, n), j0, std::min(j0 + B, n), k0, k1);
+            }
+        }
+    }
+    std::cout << std::endl;
+}
+
+// First page of the scratch file of FloydWarshalOutOfCore, the tiles follow it.
+typedef struct FWScratchHeader {
+    char magic[8];
+    uint64_t fingerprint; // Hash of the number of vertices, the tile size and the edges
+    int32_t size;
+    int32_t blockSize;
+    int32_t blocks;
+    int32_t completedBlocks; // k-blocks which are finished and synced to disk
+} fwScratchHeader_t;
+
+static const std::size_t FW_SCRATCH_HEADER_BYTES = 4096;
+
+/*
+ * Relaxes the tile dis/next of B x B entries over the B intermediate vertices of the k-block. disIK/nextIK is the tile
+ * in the same rows and the k-block columns, disKJ the tile in the k-block rows and the same columns. They may be the
+ * tile itself, see relaxTile.
+ */
+static inline void relaxBufferedTile(double* dis, int* next, const double* disIK, const int* nextIK, const double* disKJ, const std::size_t B)
+{
+    for (std::size_t k = 0; k < B; k++) {
+        const double* disK = disKJ + k * B;
+
+        for (std::size_t i = 0; i < B; i++) {
+            double* disI = dis + i * B;
+            int* nextI = next + i * B;
+            const double disIKValue = disIK[i * B + k];
+            const int nextIKValue = nextIK[i * B + k];
+
+            #pragma omp simd
+            for (std::size_t j = 0; j < B; j++) {
+                const double newDistance = disIKValue + disK[j];
+                const double oldDistance = disI[j];
+                const int oldNext = nextI[j];
+                const bool shorter = newDistance < oldDistance;
+                disI[j] = shorter ? newDistance : oldDistance;
+                nextI[j] = shorter ? nextIKValue : oldNext;
+            }
+        }
+    }
+}
+
+/*
+ * Writes a tile back to the scratch file. The next vertices are stored before the distances, so if the process is
+ * killed in between, the distances of the tile are still the old ones and the relaxation redoes the entries when it
+ * resumes. The fence only keeps the compiler from swapping the copies, it doesn't order the write-back of the pages.
+ * Only the msync after every k-block puts the tiles on disk, a crash of the machine can leave any tile written since.
+ */
+static inline void storeTile(char* tile, const double* dis, const int* next, const std::size_t B)
+{
+    std::memcpy(tile, next, B * B * sizeof(int));
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    std::memcpy(tile + B * B * sizeof(int), dis, B * B * sizeof(double));
+}
+
+static inline void loadTile(const char* tile, double* dis, int* next, const std::size_t B)
+{
+    std::memcpy(next, tile, B * B * sizeof(int));
+    std::memcpy(dis, tile + B * B * sizeof(int), B * B * sizeof(double));
+}
+
+bool FloydWarshalOutOfCore(const char* scratch, int V, const int* from, const int* to, const double* weight, std::size_t E, int* next, bool transposed)
+{
+    const std::size_t n = V;
+    const std::size_t B = FW_BLOCK_SIZE;
+    const std::size_t blocks = (n + B - 1) / B;
+    const std::size_t tileBytes = B * B * (sizeof(int) + sizeof(double));
+    const std::size_t bytes = FW_SCRATCH_HEADER_BYTES + blocks * blocks * tileBytes;
+
+    uint64_t fingerprint = FNV1A_OFFSET_BASIS;
+    fnv1a(fingerprint, &V, sizeof(V));
+    fnv1a(fingerprint, &B, sizeof(B));
+    for (std::size_t e = 0; e < E; e++) {
+        fnv1a(fingerprint, from + e, sizeof(int));
+        fnv1a(fingerprint, to + e, sizeof(int));
+        fnv1a(fingerprint, weight + e, sizeof(double));
+    }
+
+    int fd = open(scratch, O_RDWR | O_CREAT, 0644);
+    struct stat info = {};
+    if (fd == -1 || fstat(fd, &info) != 0) {
+        std::cerr << "Failed to open the scratch file " << scratch << std::endl;
+        return false;
+    }
+    fwScratchHeader_t header = {};
+    const bool resume = static_cast<std::size_t>(info.st_size) == bytes
+        && pread(fd, &header, sizeof(header), 0) == sizeof(header)
+        && std::memcmp(header.magic, FW_SCRATCH_MAGIC, sizeof(header.magic)) == 0
+        && header.fingerprint == fingerprint && header.size == V && header.blockSize == static_cast<int32_t>(B);
+    if (!resume && (ftruncate(fd, 0) != 0 || ftruncate(fd, bytes) != 0)) {
+        std::cerr << "Failed to allocate " << bytes << " bytes for the scratch file " << scratch << std::endl;
+        close(fd);
+        return false;
+    }
+    char* mapping = static_cast<char*>(mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map the scratch file " << scratch << std::endl;
+        return false;
+    }
+    fwScratchHeader_t* checkpoint = reinterpret_cast<fwScratchHeader_t*>(mapping);
+    char* tiles = mapping + FW_SCRATCH_HEADER_BYTES;
+
+    if (resume) {
+        std::cout << "Resuming Floyd Warshall from " << scratch << " after k-block " << checkpoint->completedBlocks << " of " << blocks << std::endl;
+    }
+    else {
+        // Vertices of the padding of the last tiles are not connected to anything, so they never shorten a path.
+        #pragma omp parallel for schedule(static) default(none) shared(tiles, blocks, B, tileBytes)
+        for (std::size_t t = 0; t < blocks * blocks; t++) {
+            const std::size_t ib = t / blocks;
+            const std::size_t jb = t % blocks;
+            int* tileNext = reinterpret_cast<int*>(tiles + t * tileBytes);
+            double* tileDis = reinterpret_cast<double*>(tiles + t * tileBytes + B * B * sizeof(int));
+            for (std::size_t i = 0; i < B; i++) {
+                for (std::size_t j = 0; j < B; j++) {
+                    const bool self = ib == jb && i == j;
+                    tileDis[i * B + j] = !self * 1e30;
+                    tileNext[i * B + j] = self ? static_cast<int>(ib * B + i) : -1;
+                }
+            }
+        }
+        for (std::size_t e = 0; e < E; e++) {
+            const std::size_t i = from[e];
+            const std::size_t j = to[e];
+            char* tile = tiles + ((i / B) * blocks + j / B) * tileBytes;
+            const std::size_t entry = (i % B) * B + j % B;
+            double* tileDis = reinterpret_cast<double*>(tile + B * B * sizeof(int)) + entry;
+            if (weight[e] < *tileDis) {
+                *tileDis = weight[e];
+                reinterpret_cast<int*>(tile)[entry] = to[e];
+            }
+        }
+        msync(mapping, bytes, MS_SYNC);
+
+        std::memcpy(checkpoint->magic, FW_SCRATCH_MAGIC, sizeof(checkpoint->magic));
+        checkpoint->fingerprint = fingerprint;
+        checkpoint->size = V;
+        checkpoint->blockSize = static_cast<int32_t>(B);
+        checkpoint->blocks = static_cast<int32_t>(blocks);
+        checkpoint->completedBlocks = 0;
+        msync(mapping, FW_SCRATCH_HEADER_BYTES, MS_SYNC);
+    }
+
+    // The tiles in row kb and column kb are kept in memory while the other tiles are streamed through it.
+    std::vector<double> rowDis(blocks * B * B);
+    std::vector<int> rowNext(blocks * B * B);
+    std::vector<double> columnDis(blocks * B * B);
+    std::vector<int> columnNext(blocks * B * B);
+
+    std::cout << std::endl;
+    for (std::size_t kb = checkpoint->completedBlocks; kb < blocks; kb++) {
+#ifdef SLURM_OUTPUT
+        std::cout << "k-block: " << (kb + 1) << " of " << blocks << std::endl;
+#else
+        std::cout << "\rk-block: " << (kb + 1) << " of " << blocks << std::flush;
+#endif
+        // Phase 1: The diagonal tile only depends on itself.
+        double* diagonalDis = rowDis.data() + kb * B * B;
+        int* diagonalNext = rowNext.data() + kb * B * B;
+        loadTile(tiles + (kb * blocks + kb) * tileBytes, diagonalDis, diagonalNext, B);
+        relaxBufferedTile(diagonalDis, diagonalNext, diagonalDis, diagonalNext, diagonalDis, B);
+        storeTile(tiles + (kb * blocks + kb) * tileBytes, diagonalDis, diagonalNext, B);
+        std::copy(diagonalDis, diagonalDis + B * B, columnDis.data() + kb * B * B);
+        std::copy(diagonalNext, diagonalNext + B * B, columnNext.data() + kb * B * B);
+
+        // Phase 2: Tiles in row kb and column kb only depend on themselves and on the diagonal tile.
+        #pragma omp parallel for schedule(dynamic) default(none) shared(tiles, rowDis, rowNext, columnDis, columnNext, diagonalDis, diagonalNext, B, blocks, kb, tileBytes)
+        for (std::size_t b = 0; b < 2 * blocks; b++) {
+            const std::size_t other = b % blocks;
+            if (other == kb) {
+                continue;
+            }
+            if (b < blocks) {
+                char* tile = tiles + (kb * blocks + other) * tileBytes;
+                double* dis = rowDis.data() + other * B * B;
+                int* next = rowNext.data() + other * B * B;
+                loadTile(tile, dis, next, B);
+                relaxBufferedTile(dis, next, diagonalDis, diagonalNext, dis, B);
+                storeTile(tile, dis, next, B);
+            }
+            else {
+                char* tile = tiles + (other * blocks + kb) * tileBytes;
+                double* dis = columnDis.data() + other * B * B;
+                int* next = columnNext.data() + other * B * B;
+                loadTile(tile, dis, next, B);
+                relaxBufferedTile(dis, next, dis, next, diagonalDis, B);
+                storeTile(tile, dis, next, B);
+            }
+        }
+
+        // Phase 3: All remaining tiles only depend on their row and column tile computed in phase 2.
+        #pragma omp parallel default(none) shared(tiles, rowDis, columnDis, columnNext, B, blocks, kb, tileBytes)
+        {
+            std::vector<double> dis(B * B);
+            std::vector<int> next(B * B);
+
+            #pragma omp for collapse(2) schedule(dynamic)
+            for (std::size_t ib = 0; ib < blocks; ib++) {
+                for (std::size_t jb = 0; jb < blocks; jb++) {
+                    if (ib == kb || jb == kb) {
+                        continue;
+                    }
+                    char* tile = tiles + (ib * blocks + jb) * tileBytes;
+                    loadTile(tile, dis.data(), next.data(), B);
+                    relaxBufferedTile(dis.data(), next.data(), columnDis.data() + ib * B * B, columnNext.data() + ib * B * B, rowDis.data() + jb * B * B, B);
+                    storeTile(tile, dis.data(), next.data(), B);
+                }
+            }
+        }
+
+        // Checkpoint, the tiles have to be on disk before the header says that the k-block is finished.
+        msync(mapping, bytes, MS_SYNC);
+        checkpoint->completedBlocks = static_cast<int32_t>(kb + 1);
+        msync(mapping, FW_SCRATCH_HEADER_BYTES, MS_SYNC);
+    }
+    std::cout << std::endl;
+
+    #pragma omp parallel for schedule(static) default(none) shared(tiles, next, n, B, blocks, tileBytes, transposed)
+    for (std::size_t t = 0; t < blocks * blocks; t++) {
+        const std::size_t i0 = (t / blocks) * B;
+        const std::size_t j0 = (t % blocks) * B;
+        const int* tileNext = reinterpret_cast<const int*>(tiles + t * tileBytes);
+        for (std::size_t i = i0; i < std::min(i0 + B, n); i++) {
+            for (std::size_t j = j0; j < std::min(j0 + B, n); j++) {
+                next[transposed ? j * n + i : i * n + j] = tileNext[(i - i0) * B + j - j0];
+            }
+        }
+    }
+    munmap(mapping, bytes);
+    return true;
+}
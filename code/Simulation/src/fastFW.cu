@@ -40,6 +40,34 @@ void GPUInnerLoops(double *dis, int *next, int k, int V) {
         }
     }
 
+/*
+ * GPUInnerLoops for two graphs with interleaved rows, entry (i, j) of graph l is at (2 * i + l) * V + j. Each thread
+ * relaxes the cell in both graphs, so one launch per k covers both.
+ */
+__global__
+void GPUInnerLoopsPair(double *dis, int *next, int k, int V) {
+    int t = (blockDim.x*blockDim.y)*threadIdx.z+(threadIdx.y*blockDim.x)+(threadIdx.x);
+    int b = (gridDim.x*gridDim.y)*blockIdx.z+(blockIdx.y*gridDim.x)+(blockIdx.x);
+    int T = blockDim.x*blockDim.y*blockDim.z;
+    int B = gridDim.x*gridDim.y*gridDim.z;
+
+    for (int i=b; i<V; i+=B)
+    {
+        for (int l=0; l<2; l++)
+        {
+            const size_t rowI = static_cast<size_t>(2 * i + l) * V;
+            const size_t rowK = static_cast<size_t>(2 * k + l) * V;
+            for(int j=t; j<V; j+=T)
+            {
+                if (dis[rowI + k] + dis[rowK + j] < dis[rowI + j]) {
+                    dis[rowI + j] = dis[rowI + k] + dis[rowK + j];
+                    next[rowI + j] = next[rowI + k];
+                }
+            }
+        }
+    }
+}
+
 void FloydWarshal(double* dis, int* next, int V){
     double* distance;
     int* neighbour;
@@ -88,6 +116,47 @@ void FloydWarshal(double* dis, int* next, int V){
     assert(result == cudaSuccess && "Failed to copy neighbour array to CPU");
 }
 
+void FloydWarshalPair(double* dis, int* next, int V){
+    double* distance;
+    int* neighbour;
+    const size_t elements = 2 * static_cast<size_t>(V) * V;
+
+    // Allocate Memory on GPU
+    auto alresult = cudaMallocManaged(&distance, elements * sizeof(double));
+    assert(alresult == cudaSuccess && "Failed to allocate memory on GPU for distance");
+    alresult = cudaMallocManaged(&neighbour, elements * sizeof(int));
+    assert(alresult == cudaSuccess && "Failed to allocate memory on GPU for neighbour");
+
+    auto result = cudaMemcpy(distance, dis, elements * sizeof(double), cudaMemcpyHostToDevice);
+    assert(result == cudaSuccess && "Failed to copy distance array to GPU");
+    result = cudaMemcpy(neighbour, next, elements * sizeof(int), cudaMemcpyHostToDevice);
+    assert(result == cudaSuccess && "Failed to copy neighbour array to GPU");
+
+    std::cout << std::endl;
+    for (int k = 0; k < V; k++)
+    {
+#ifdef SLURM_OUTPUT
+        std::cout << "k: " << (k + 1) << " of " << V << std::endl;
+#else
+        std::cout << "\rk: " << (k + 1) << " of " << V << std::flush;
+#endif
+
+        GPUInnerLoopsPair<<<dim3(CUDA_SCALAR,1,1),dim3(1024,1,1)>>>(distance,neighbour,k,V);
+        alresult = cudaGetLastError();
+        assert(alresult == cudaSuccess && "Failed to launch GPUInnerLoopsPair kernel");
+        result = cudaDeviceSynchronize();
+        assert(result == cudaSuccess && "Failed to synchronize GPU");
+    }
+    std::cout << std::endl;
+
+    result = cudaMemcpy(dis, distance, elements * sizeof(double), cudaMemcpyDeviceToHost);
+    assert(result == cudaSuccess && "Failed to copy distance array to CPU");
+    result = cudaMemcpy(next, neighbour, elements * sizeof(int), cudaMemcpyDeviceToHost);
+    assert(result == cudaSuccess && "Failed to copy neighbour array to CPU");
+    cudaFree(distance);
+    cudaFree(neighbour);
+}
+
 #endif
 
 
@@ -1,12 +1,21 @@
 #include <string>
 #include <iostream>
 #include <map>
+#include <set>
+#include <functional>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "update.hpp"
 #include "io.hpp"
 #include "actors.hpp"
 #include "routing.hpp"
 #include "base64.hpp"
+#include "utils.hpp"
+#include "fnv1a.hpp"
 
 bool loadFile(const std::string file, json* input)
 {
@@ -25,6 +34,45 @@ bool hasPrecompute(const json* map)
     return map->contains("world") && map->contains("carTree") && map->contains("bikeTree");
 }
 
+bool applyMapDiff(json* map, const json* diff)
+{
+    std::set<std::string> intersections;
+    for (const auto& intersection : map->at("intersections")) {
+        intersections.insert(intersection["id"].get<std::string>());
+    }
+    json& roads = map->at("roads");
+
+    if (diff->contains("removeRoads")) {
+        for (const auto& id : diff->at("removeRoads")) {
+            auto road = std::find_if(roads.begin(), roads.end(), [&id](const json& r) { return r["id"] == id; });
+            if (road == roads.end()) {
+                std::cerr << "Map diff removes unknown road " << id << std::endl;
+                return false;
+            }
+            roads.erase(road);
+        }
+    }
+
+    if (diff->contains("roads")) {
+        for (const auto& changed : diff->at("roads")) {
+            for (const char* end : {"start", "end"}) {
+                if (intersections.count(changed["intersections"][end]["id"].get<std::string>()) == 0) {
+                    std::cerr << "Road " << changed["id"] << " of the map diff connects unknown intersection " << changed["intersections"][end]["id"] << std::endl;
+                    return false;
+                }
+            }
+            auto road = std::find_if(roads.begin(), roads.end(), [&changed](const json& r) { return r["id"] == changed["id"]; });
+            if (road == roads.end()) {
+                roads.push_back(changed);
+            }
+            else {
+                *road = changed;
+            }
+        }
+    }
+    return true;
+}
+
 void importMap(world_t* world, json* map, bool doTrafficLights)
 {
     assert(world->streets.size() == 0 && "Streets is not empty");
@@ -148,17 +196,22 @@ void connectOpposite(world_t* world, const std::map<std::string, street_t*> look
     }
 }
 
-void importAgents(world_t* world, json* agents, spt_t* carsSPT, spt_t* bikeSPT)
+typedef std::function<void(std::size_t, std::size_t, ActorTypes)> BatchRouter;
+
+/*
+ * Imports the agents, route sets the paths of the actors [first, last) of the world, which are all of the given type.
+ */
+static void importAgentsRouted(world_t* world, json* agents, const BatchRouter& route)
 {
     assert(world->actors.size() == 0 && "Agents is not empty");
-    world->actors = std::vector<Actor*>(agents->at("bikes").size() + agents->at("cars").size());
+    allocateActors(world, agents->at("bikes").size() + agents->at("cars").size());
     std::cout << "importing " << agents->at("bikes").size() << " bikes and " << agents->at("cars").size() << " cars" << std::endl;
     int index = 0;
     int failed = 0;
 
     // Import Bikes
     for (const auto& [name, data] : agents->at("bikes").items()) {
-        Actor* actor = new Actor();
+        Actor* actor = &world->actorArena.at(index);
 
         // Set that shit
         actor->type = ActorTypes::Bike;
@@ -171,33 +224,21 @@ void importAgents(world_t* world, json* agents, spt_t* carsSPT, spt_t* bikeSPT)
 
         actor->acceleration = data["acceleration"];
         actor->deceleration = data["deceleration"];
-        actor->acceleration_exp = data["acceleration_exponent"];
+        setAccelerationExponent(actor, data["acceleration_exponent"]);
 
         actor->insertAfter = data["waiting_period"];
-        actor->id = name;
+        actor->id = addAgentId(world, name);
 
         actor->start_id = world->string_to_int[data["start_id"]];
         actor->end_id = world->string_to_int[data["end_id"]];
 
-        actor->path = retrievePath(bikeSPT, actor->start_id, actor->end_id);
-
-        if ((actor->start_id != -1 && actor->end_id != -1) || actor->path.empty()) { // Well this is also a stupid mistace to have it to == and ||
-            for (auto& intersection : world->intersections) {
-                if (intersection.id == actor->start_id) {
-                    intersection.waitingToBeInserted.push_back(actor);
-                    break;
-                }
-            }
-        }
-        else {
-            failed++;
-        }
-
         world->actors.at(index) = actor;
         index++;
     }
+    const std::size_t bikes = index;
+
     for (const auto& [name, data] : agents->at("cars").items()) {
-        Actor* actor = new Actor();
+        Actor* actor = &world->actorArena.at(index);
 
         // Set that shit
         actor->type = ActorTypes::Car; // TODO THIS FUCKING LINE OF MY IDIOT BRAIN WAS IT
@@ -210,19 +251,29 @@ void importAgents(world_t* world, json* agents, spt_t* carsSPT, spt_t* bikeSPT)
 
         actor->acceleration = data["acceleration"];
         actor->deceleration = data["deceleration"];
-        actor->acceleration_exp = data["acceleration_exponent"];
+        setAccelerationExponent(actor, data["acceleration_exponent"]);
 
         actor->insertAfter = data["waiting_period"];
-        actor->id = name;
+        actor->id = addAgentId(world, name);
 
         actor->start_id = world->string_to_int[data["start_id"]];
         actor->end_id = world->string_to_int[data["end_id"]];
 
-        actor->path = retrievePath(carsSPT, actor->start_id, actor->end_id);
+        world->actors.at(index) = actor;
+        index++;
+    }
 
+    route(0, bikes, ActorTypes::Bike);
+    route(bikes, world->actors.size(), ActorTypes::Car);
+
+    for (Actor* actor : world->actors) {
         // Make sure the path exists.
-        if (actor->start_id != -1 && actor->end_id != -1) {
-            for (auto &intersection: world->intersections) {
+        const bool valid = (actor->type == ActorTypes::Bike)
+            ? (actor->start_id != -1 && actor->end_id != -1) || pathEmpty(&actor->path) // Well this is also a stupid mistace to have it to == and ||
+            : actor->start_id != -1 && actor->end_id != -1;
+
+        if (valid) {
+            for (auto& intersection : world->intersections) {
                 if (intersection.id == actor->start_id) {
                     intersection.waitingToBeInserted.push_back(actor);
                     break;
@@ -232,15 +283,55 @@ void importAgents(world_t* world, json* agents, spt_t* carsSPT, spt_t* bikeSPT)
         else {
             failed++;
         }
-
-        world->actors.at(index) = actor;
-        index++;
     }
 
     std::cout << "Found " << failed << " agents with impossible destinations" << std::endl;
 }
 
-json exportWorld(const world_t* world, const float& time, const float& timeDelta, const json* originMap)
+void importAgents(world_t* world, json* agents, spt_t* carsSPT, spt_t* bikeSPT)
+{
+    // The paths are walked in the trees while the actors drive, so only the first hop is looked up here.
+    importAgentsRouted(world, agents, [=](std::size_t first, std::size_t last, ActorTypes type) {
+        const spt_t* tree = (type == ActorTypes::Bike) ? bikeSPT : carsSPT;
+        for (std::size_t i = first; i < last; i++) {
+            Actor* actor = world->actors.at(i);
+            setTreePath(&actor->path, tree, actor->start_id, actor->end_id);
+        }
+    });
+}
+
+void importAgents(world_t* world, json* agents, const ch_t* carsCH, const ch_t* bikeCH)
+{
+    importAgentsRouted(world, agents, [=](std::size_t first, std::size_t last, ActorTypes type) {
+        std::vector<std::pair<int, int>> queries;
+        queries.reserve(last - first);
+        for (std::size_t i = first; i < last; i++) {
+            queries.emplace_back(world->actors.at(i)->start_id, world->actors.at(i)->end_id);
+        }
+
+        std::vector<Path> paths = retrievePaths((type == ActorTypes::Bike) ? bikeCH : carsCH, queries);
+        for (std::size_t i = first; i < last; i++) {
+            setQueuedPath(&world->actors.at(i)->path, std::move(paths.at(i - first)));
+        }
+    });
+}
+
+std::vector<int> agentDestinations(const world_t* world, const json* agents, const std::string& type)
+{
+    std::vector<int> destinations;
+    destinations.reserve(agents->at(type).size());
+
+    for (const auto& [name, data] : agents->at(type).items()) {
+        auto iter = world->string_to_int.find(data["end_id"]);
+        if (iter != world->string_to_int.end() && iter->second != -1) {
+            destinations.push_back(iter->second);
+        }
+    }
+    return destinations;
+}
+
+json exportWorld(const world_t* world, const float& time, const float& timeDelta, const json* originMap,
+                 const spt_t* carsSPT, const spt_t* bikeSPT)
 {
     json output;
 
@@ -256,9 +347,10 @@ json exportWorld(const world_t* world, const float& time, const float& timeDelta
     int no_path = 0;
 
     for (const auto& actor : world->actors) {
-        output["setup"]["agents"][actor->id] = {};
-        json& obj = output["setup"]["agents"][actor->id];
-        obj["id"] = actor->id;
+        const std::string id = agentId(world, actor);
+        output["setup"]["agents"][id] = {};
+        json& obj = output["setup"]["agents"][id];
+        obj["id"] = id;
         obj["type"] = actor->type == ActorTypes::Car ? "car" : "bike";
         obj["length"] = actor->length;
         obj["max_velocity"] = actor->max_velocity * 3.6f;
@@ -266,10 +358,24 @@ json exportWorld(const world_t* world, const float& time, const float& timeDelta
         obj["deceleration"] = actor->deceleration;
         obj["acceleration_exponent"] = actor->acceleration_exp;
         obj["waiting_period"] = actor->insertAfter;
-        obj["travel_distance"] = distanceFromPath(world, actor);
+        // The distance companion of the tree has the length of the path, so it doesn't have to be walked. Its
+        // distances are the weights of Floyd Warshall, which are only the lengths of the streets without ALTFW.
+        const spt_t* tree = (actor->type == ActorTypes::Car) ? carsSPT : bikeSPT;
+#ifdef ALTFW
+        tree = nullptr;
+#endif
+        if (pathEmpty(&actor->path)) {
+            obj["travel_distance"] = 0.0f;
+        }
+        else if (tree != nullptr && hasDistances(tree)) {
+            obj["travel_distance"] = static_cast<float>(pathDistance(tree, actor->start_id, actor->end_id));
+        }
+        else {
+            obj["travel_distance"] = distanceFromPath(world, actor);
+        }
         obj["street_path"] = StreetPath(actor, world);
         obj["vertex_path"] = getPath(actor, world);
-        if (actor->path.empty()) {
+        if (pathEmpty(&actor->path)) {
             obj["start_crossing_id"] = "NO_PATH_FOUND";
             obj["end_crossing_id"] = "NO_PATH_FOUND";
         }
@@ -277,7 +383,7 @@ json exportWorld(const world_t* world, const float& time, const float& timeDelta
             obj["start_crossing_id"] = world->int_to_string.at(actor->start_id);
             obj["end_crossing_id"] = world->int_to_string.at(actor->end_id);
         }
-        no_path += actor->path.empty() ? 1 : 0;
+        no_path += pathEmpty(&actor->path) ? 1 : 0;
     }
     std::cout << "No path found with  " << no_path << " agents." << std::endl << std::endl;
     return output;
@@ -290,9 +396,10 @@ void addFrame(world_t* world, json* out, const bool final)
     json intersectionFrame;
 
     // Lambda function to create json object to add to output.
-    auto a = [&actorFrame, &final](const Actor* actor, const Street* street, const float percent, bool active) {
-        actorFrame[actor->id] = {};
-        json& obj = actorFrame[actor->id];
+    auto a = [&actorFrame, &final, world](const Actor* actor, const Street* street, const float percent, bool active) {
+        const std::string id = agentId(world, actor);
+        actorFrame[id] = {};
+        json& obj = actorFrame[id];
         obj["road"] = street->id;
         obj["percent_to_end"] = percent;
         obj["distance_to_side"] = actor->distanceToRight * 10.0f;
@@ -339,11 +446,11 @@ void addFrame(world_t* world, json* out, const bool final)
         for (const auto& actor : intersection.waitingToBeInserted) {
 //            assert(actor->start_id == intersection.id && "Actor start id does not match intersection id");
             Street* street;
-            if (actor->path.empty()) {
+            if (pathEmpty(&actor->path)) {
                 street = &world->empty;
             }
             else {
-                int first = actor->path.front();
+                int first = pathFront(&actor->path);
                 if (actor->type == ActorTypes::Car) {
                     street = intersection.outboundCar.find(first)->second;
                 }
@@ -407,8 +514,8 @@ void exportSPT(const spt_t& carTree, const spt_t& bikeTree, const json& input,
         bikeReachable[world->int_to_string.at(i)] = {};
 
         for (int j = 0; j < carTree.size; j++) {
-            carReachable[world->int_to_string.at(i)][world->int_to_string.at(j)] = carTree.array[i * carTree.size + j] != -1;
-            bikeReachable[world->int_to_string.at(i)][world->int_to_string.at(j)] = bikeTree.array[i * bikeTree.size + j] != -1;
+            carReachable[world->int_to_string.at(i)][world->int_to_string.at(j)] = nextHop(&carTree, i, j) != -1;
+            bikeReachable[world->int_to_string.at(i)][world->int_to_string.at(j)] = nextHop(&bikeTree, i, j) != -1;
         }
         nlohmann::json carJson;
         carJson["carTree"] = carReachable;
@@ -435,11 +542,11 @@ void exportSPT(const spt_t& carTree, const spt_t& bikeTree, const json& input, j
     #pragma omp parallel for default(none) shared(carTree, carReachable, world, bikeTree, bikeReachable)
     for (int i = 0; i < carTree.size; i++) {
         for (int j = 0; j < carTree.size; j++) {
-            if (carTree.array[i * carTree.size + j] == -1) {
-                carReachable[world->int_to_string.at(i)][world->int_to_string.at(j)] = carTree.array[i * carTree.size + j] != -1;
+            if (nextHop(&carTree, i, j) == -1) {
+                carReachable[world->int_to_string.at(i)][world->int_to_string.at(j)] = nextHop(&carTree, i, j) != -1;
             }
-            if (bikeTree.array[i * bikeTree.size + j] == -1) {
-                bikeReachable[world->int_to_string.at(i)][world->int_to_string.at(j)] = bikeTree.array[i * bikeTree.size + j] != -1;
+            if (nextHop(&bikeTree, i, j) == -1) {
+                bikeReachable[world->int_to_string.at(i)][world->int_to_string.at(j)] = nextHop(&bikeTree, i, j) != -1;
             }
         }
     }
@@ -493,14 +600,82 @@ void importSPT(spt_t* carTree, spt_t* bikeTree, const json* input, world_t* worl
     }
 }
 
-bool binDumpSpt(spt_t* Tree, const char* file_name)
+/*
+ * Bit mask of the street types a tree is computed for.
+ */
+static uint32_t streetTypeMask(const std::vector<StreetTypes>& include)
+{
+    uint32_t mask = 0;
+    for (const auto& type : include) {
+        mask |= 1u << type;
+    }
+    return mask;
+}
+
+uint64_t mapFingerprint(const world_t* world)
+{
+    uint64_t hash = FNV1A_OFFSET_BASIS;
+
+    for (const auto& [index, id] : world->int_to_string) {
+        fnv1a(hash, &index, sizeof(index));
+        fnv1a(hash, id.data(), id.size() + 1);
+    }
+    for (const auto& street : world->streets) {
+        const double weight = streetWeight(street);
+        fnv1a(hash, street.id.data(), street.id.size() + 1);
+        fnv1a(hash, &street.start, sizeof(street.start));
+        fnv1a(hash, &street.end, sizeof(street.end));
+        fnv1a(hash, &street.type, sizeof(street.type));
+        fnv1a(hash, &weight, sizeof(weight));
+    }
+    return hash;
+}
+
+bool binDumpSpt(spt_t* Tree, const char* file_name, const world_t* world, const std::vector<StreetTypes>& include)
 {
-    void *carTreePtr = Tree->array;
-    unsigned char *carTreeChar = static_cast<unsigned char *>(carTreePtr);
-    std::string ostring = base64_encode(carTreeChar, Tree->size * Tree->size * sizeof(int));
+    if (Tree->column != nullptr) {
+        std::cerr << "Demand driven trees can't be dumped, they only contain some destinations" << std::endl;
+        return false;
+    }
 
-    std::ofstream f(file_name);
-    f << ostring;
+    sptFileHeader_t header = {};
+    std::memcpy(header.magic, SPT_FILE_MAGIC, sizeof(header.magic));
+    header.version = SPT_FILE_VERSION;
+    header.size = Tree->size;
+    header.elementBits = (Tree->slots != nullptr) ? Tree->slotBits : 32;
+    header.streetTypes = streetTypeMask(include);
+    header.fingerprint = mapFingerprint(world);
+    header.neighbourCount = (Tree->slots != nullptr) ? Tree->neighbourOffset[Tree->size] : 0;
+    header.flags = (Tree->destinationMajor ? SPT_FILE_DESTINATION_MAJOR : 0) | (Tree->distance != nullptr ? SPT_FILE_DISTANCES : 0);
+    if (Tree->chains != nullptr) {
+        header.flags = (Tree->chains->tree.destinationMajor ? SPT_FILE_DESTINATION_MAJOR : 0) | SPT_FILE_CHAINS;
+        header.reducedSize = Tree->chains->tree.size;
+    }
+
+    std::ofstream f(file_name, std::ios::binary);
+    if (!f.is_open()) {
+        std::cerr << "Failed to save to " << file_name << std::endl;
+        return false;
+    }
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (Tree->chains != nullptr) {
+        const std::size_t elements = header.reducedSize * header.reducedSize;
+        f.write(reinterpret_cast<const char*>(Tree->chains->tree.array), static_cast<std::streamsize>(elements * sizeof(int)));
+        f.write(reinterpret_cast<const char*>(Tree->chains->distance), static_cast<std::streamsize>(elements * sizeof(float)));
+    }
+    else if (Tree->slots != nullptr) {
+        f.write(reinterpret_cast<const char*>(Tree->neighbourOffset), static_cast<std::streamsize>((Tree->size + 1) * sizeof(int)));
+        f.write(reinterpret_cast<const char*>(Tree->neighbours), static_cast<std::streamsize>(header.neighbourCount * sizeof(int)));
+        f.write(reinterpret_cast<const char*>(Tree->slots), static_cast<std::streamsize>(Tree->size * Tree->rowBytes));
+    }
+    else {
+        f.write(reinterpret_cast<const char*>(Tree->array), static_cast<std::streamsize>(static_cast<std::size_t>(Tree->size) * Tree->size * sizeof(int)));
+    }
+    if (Tree->chains == nullptr && Tree->distance != nullptr) {
+        const char padding[sizeof(float)] = {};
+        f.write(padding, static_cast<std::streamsize>((sizeof(float) - f.tellp() % sizeof(float)) % sizeof(float)));
+        f.write(reinterpret_cast<const char*>(Tree->distance), static_cast<std::streamsize>(static_cast<std::size_t>(Tree->size) * Tree->size * sizeof(float)));
+    }
     f.close();
     return true;
 }
@@ -545,13 +720,17 @@ void jsonDumpStats(const float& avgTime, json* output, world_t* world, const boo
 }
 
 
-bool binLoadTree(spt_t* SPT, const char* file_name, const world_t* world)
+/*
+ * Loads a tree written before the binary format existed, the base64 encoded next hops are decoded and copied.
+ */
+static bool binLoadLegacyTree(spt_t* SPT, const char* file_name, const world_t* world)
 {
     std::ifstream f(file_name);
     if (!f.is_open()) {
         std::cerr << "Failed to load " << file_name << std::endl;
         return false;
     }
+    std::cout << file_name << " is base64 encoded, MAKE SURE THAT THE MAP MATCHES THE SPT" << std::endl;
 
     std::stringstream b64stuff;
     b64stuff << f.rdbuf();
@@ -573,6 +752,144 @@ bool binLoadTree(spt_t* SPT, const char* file_name, const world_t* world)
     return true;
 }
 
+bool binLoadTree(spt_t* SPT, const char* file_name, const world_t* world, const std::vector<StreetTypes>& include)
+{
+    int fd = open(file_name, O_RDONLY);
+    if (fd == -1) {
+        std::cerr << "Failed to load " << file_name << std::endl;
+        return false;
+    }
+
+    struct stat info = {};
+    char magic[sizeof(SPT_FILE_MAGIC) - 1] = {};
+    if (fstat(fd, &info) != 0 || pread(fd, magic, sizeof(magic), 0) != sizeof(magic)
+        || std::memcmp(magic, SPT_FILE_MAGIC, sizeof(magic)) != 0) {
+        close(fd);
+        return binLoadLegacyTree(SPT, file_name, world);
+    }
+
+    // Private mapping, so writing to the tree never changes the file.
+    const std::size_t bytes = info.st_size;
+    void* mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map " << file_name << std::endl;
+        return false;
+    }
+
+    const sptFileHeader_t* header = static_cast<const sptFileHeader_t*>(mapping);
+    const std::size_t V = world->intersections.size();
+    const bool encoded = bytes >= sizeof(sptFileHeader_t) && header->elementBits != 32;
+    const bool contracted = bytes >= sizeof(sptFileHeader_t) && (header->flags & SPT_FILE_CHAINS) != 0;
+    const std::size_t R = contracted ? header->reducedSize : 0;
+    const std::size_t rowBytes = encoded ? (V * header->elementBits + 7) / 8 : 0;
+    std::size_t dataBytes = encoded ? (V + 1 + header->neighbourCount) * sizeof(int) + V * rowBytes : V * V * sizeof(int);
+    if (contracted) {
+        dataBytes = R * R * (sizeof(int) + sizeof(float));
+    }
+    const bool distances = !contracted && bytes >= sizeof(sptFileHeader_t) && (header->flags & SPT_FILE_DISTANCES) != 0;
+    const std::size_t distanceOffset = (dataBytes + sizeof(float) - 1) / sizeof(float) * sizeof(float);
+    if (distances) {
+        dataBytes = distanceOffset + V * V * sizeof(float);
+    }
+    std::string error;
+    chains_t* chains = nullptr;
+
+    if (bytes < sizeof(sptFileHeader_t) || header->version != SPT_FILE_VERSION) {
+        error = "has an unsupported version";
+    }
+    else if (header->size != V) {
+        error = "has " + std::to_string(header->size) + " intersections, the map has " + std::to_string(V);
+    }
+    else if (header->elementBits != 32 && header->elementBits != 8 && header->elementBits != 4) {
+        error = "has next hops of " + std::to_string(header->elementBits) + " bits";
+    }
+    else if (header->streetTypes != streetTypeMask(include)) {
+        error = "was computed for other street types";
+    }
+    else if (header->fingerprint != mapFingerprint(world)) {
+        error = "was computed for a different map";
+    }
+    else if (bytes != sizeof(sptFileHeader_t) + dataBytes) {
+        error = "is truncated";
+    }
+    else if (contracted) {
+        chains = contractChains(world, include);
+        if (chains->core.size() != R) {
+            error = "has " + std::to_string(R) + " intersections outside of chains, the map has " + std::to_string(chains->core.size());
+            delete chains;
+        }
+    }
+
+    if (!error.empty()) {
+        std::cerr << "Shortest path tree " << file_name << " " << error << std::endl;
+        munmap(mapping, bytes);
+        return false;
+    }
+
+    char* data = static_cast<char*>(mapping) + sizeof(sptFileHeader_t);
+    SPT->size = static_cast<int>(V);
+    SPT->column = nullptr;
+    SPT->mapping = mapping;
+    SPT->mappingSize = bytes;
+    SPT->destinationMajor = (header->flags & SPT_FILE_DESTINATION_MAJOR) != 0;
+    SPT->chains = chains;
+    SPT->distance = distances ? reinterpret_cast<float*>(data + distanceOffset) : nullptr;
+    if (contracted) {
+        SPT->array = nullptr;
+        SPT->slots = nullptr;
+        chains->tree.array = reinterpret_cast<int*>(data);
+        chains->tree.size = static_cast<int>(R);
+        chains->tree.destinationMajor = SPT->destinationMajor;
+        chains->distance = reinterpret_cast<float*>(data + R * R * sizeof(int));
+    }
+    else if (encoded) {
+        SPT->array = nullptr;
+        SPT->slotBits = static_cast<int>(header->elementBits);
+        SPT->rowBytes = rowBytes;
+        SPT->neighbourOffset = reinterpret_cast<int*>(data);
+        SPT->neighbours = SPT->neighbourOffset + V + 1;
+        SPT->slots = reinterpret_cast<unsigned char*>(SPT->neighbours + header->neighbourCount);
+    }
+    else {
+        SPT->array = reinterpret_cast<int*>(data);
+        SPT->slots = nullptr;
+    }
+    std::cout << "Mapped SPT of size " << dataBytes << " with " << header->elementBits << " bits per next hop" << std::endl;
+    return true;
+}
+
+void freeSPT(spt_t* SPT)
+{
+    if (SPT->chains != nullptr) {
+        if (SPT->mapping == nullptr) {
+            delete[] SPT->chains->tree.array;
+            delete[] SPT->chains->distance;
+        }
+        delete SPT->chains;
+        SPT->chains = nullptr;
+    }
+    if (SPT->mapping != nullptr) {
+        munmap(SPT->mapping, SPT->mappingSize);
+    }
+    else {
+        delete[] SPT->array;
+        delete[] SPT->distance;
+        delete[] SPT->slots;
+        delete[] SPT->neighbourOffset;
+        delete[] SPT->neighbours;
+    }
+    delete[] SPT->column;
+    SPT->array = nullptr;
+    SPT->column = nullptr;
+    SPT->slots = nullptr;
+    SPT->neighbourOffset = nullptr;
+    SPT->neighbours = nullptr;
+    SPT->distance = nullptr;
+    SPT->mapping = nullptr;
+    SPT->mappingSize = 0;
+}
+
 void exportAgents(json* out, const world_t* world)
 {
     (*out)["bikes"] = {};
@@ -581,7 +898,7 @@ void exportAgents(json* out, const world_t* world)
     int empty = 0;
 
     for (auto& agent : world->actors) {
-        if (agent->path.empty()) {
+        if (pathEmpty(&agent->path)) {
             empty++;
             continue;
         }
@@ -595,16 +912,12 @@ void exportAgents(json* out, const world_t* world)
         obj["waiting_period"] = agent->insertAfter;
         obj["start_id"] = world->int_to_string.at(agent->start_id);
         obj["end_id"] = world->int_to_string.at(agent->end_id);
-        obj["path"] = std::vector<int>();
-        for (int i = 0; i < agent->path.size(); i++) {
-            obj["path"].push_back(agent->path.front());
-            agent->path.pop();
-        }
+        obj["path"] = pathIntersections(&agent->path);
         if (agent->type == ActorTypes::Car) {
-            out->at("cars")[agent->id] = obj;
+            out->at("cars")[agentId(world, agent)] = obj;
         }
         else if (agent->type == ActorTypes::Bike) {
-            out->at("bikes")[agent->id] = obj;
+            out->at("bikes")[agentId(world, agent)] = obj;
         }
     }
     std::cout << "Number of Actors with empty Path: " << empty << std::endl;
@@ -630,7 +943,7 @@ void printSPT(const spt_t* SPT)
         std::cout << std::left << std::setw(temp) << std::setfill(' ') << i;
         std::cout << "| ";
         for (int j = 0; j < SPT->size; j++) {
-            std::cout << std::left << std::setw(temp) << std::setfill(' ') <<  SPT->array[i * SPT->size + j];
+            std::cout << std::left << std::setw(temp) << std::setfill(' ') <<  nextHop(SPT, i, j);
         }
         std::cout << std::endl;
     }
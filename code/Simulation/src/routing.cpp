@@ -2,8 +2,15 @@
 
 #include <iostream>
 #include <algorithm>
+#include <queue>
+#include <functional>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "fastFW.cuh"
+#include "cpuFW.hpp"
 #include "routing.hpp"
 #include <cassert>
 
@@ -12,236 +19,1452 @@
 // Intersection vertex into multiple vertecies representing the intersection with each new vertex only containing roads with
 // identical turning sets.
 
-// Compute Floyd-Warshal on entire graph to find the shortest path from a to b.
-#ifndef USE_CUDA
-spt_t calculateShortestPathTree(const world_t* world, const std::vector<StreetTypes>& include)
+double streetWeight(const Street& street)
 {
-    spt_t sopatree = {
-        .array = new int[world->intersections.size() * world->intersections.size()],
-        .size = static_cast<int>(world->intersections.size()),
-    };
-    float* minimumDistance = new float[sopatree.size * sopatree.size];
+#ifdef ALTFW
+    return street.length / (street.speedlimit * street.width);
+#else
+    return street.length;
+#endif
+}
 
-    // Initialize the distance and neighbour arrays
-    for (int start = 0; start < sopatree.size; start++) {
-        for (int end = 0; end < sopatree.size; end++) {
-            *(minimumDistance + start * sopatree.size + end) = (start != end) * 1e30; // Initializing the default distance between nodes
-            *(sopatree.array + start * sopatree.size + end) = (start == end) * start + (start != end) * -1; // Initializing the default neighbour
-        }
+bool parseFWBackend(const std::string& name, FWBackend& backend)
+{
+    if (name == "cuda") {
+        backend = FWBackend::CudaFW;
+    }
+    else if (name == "cpu") {
+        backend = FWBackend::BlockedFW;
+    }
+    else if (name == "naive") {
+        backend = FWBackend::NaiveFW;
     }
+    else {
+        return false;
+    }
+    return true;
+}
 
+// Edge of the graph Floyd Warshall runs on. hop is the intersection of the full graph the edge leads to first.
+typedef struct FWEdge {
+    int from;
+    int to;
+    int hop;
+    double weight;
+} fwEdge_t;
+
+/* The streets of the given types as edges of the graph of all intersections. */
+static std::vector<fwEdge_t> streetEdges(const world_t* world, const std::vector<StreetTypes>& include)
+{
+    std::vector<fwEdge_t> edges;
     for (const auto& street : world->streets) {
         if (std::find(include.begin(), include.end(), street.type) != include.end()) {
-            // Access the matrix as a 1D array.
-#ifdef ALTFW
-            float streetDistance = street.length / (street.speedlimit * street.width);
-#else
-            float streetDistance = street.length;
-#endif
-            *(minimumDistance + street.start * sopatree.size + street.end) = std::min(streetDistance,
-                    *(minimumDistance + street.start * sopatree.size + street.end));
-            *(sopatree.array + street.start * sopatree.size + street.end) = street.end;
+            edges.push_back({street.start, street.end, street.end, streetWeight(street)});
+        }
+    }
+    return edges;
+}
+
+/*
+ * Initializes the distances and next hops of a graph with V vertices for Floyd Warshall, entry (i, j) is at
+ * i * stride + j. The next hops are the hops of the edges, names maps the vertices to intersections for the warning
+ * about streets which are in the graph twice.
+ */
+static void initializeFloydWarshall(const world_t* world, const std::vector<int>* names, const int V, const std::vector<fwEdge_t>& edges,
+                                    double* distance, int* neighbour, const std::size_t stride)
+{
+    for (std::size_t start = 0; start < static_cast<std::size_t>(V); start++) {
+        const int self = (names == nullptr) ? static_cast<int>(start) : names->at(start);
+        for (std::size_t end = 0; end < static_cast<std::size_t>(V); end++) {
+            *(distance + start * stride + end) = (start != end) * 1e30; // Initializing the default distance between nodes
+            *(neighbour + start * stride + end) = (start == end) * self + (start != end) * -1; // Initializing the default neighbour
+        }
+    }
+
+    // Add Distance of Streets to the distance array
+    for (const auto& edge : edges) {
+        std::size_t start = edge.from;
+        std::size_t end = edge.to;
+        const int fullStart = (names == nullptr) ? edge.from : names->at(edge.from);
+        const int fullEnd = (names == nullptr) ? edge.to : names->at(edge.to);
+        // Take the shortest street in case there are multiple (for what ever reason there should be multiple
+        if (*(distance + start * stride + end) < 1e30 && edge.hop == fullEnd) {
+            std::cout << "Road twice in graph" << std::endl;
+            std::cout << "Start: " << world->int_to_string.at(fullStart) << " End: " << world->int_to_string.at(fullEnd) << std::endl;
+        }
+        if (edge.weight < *(distance + start * stride + end)) {
+            *(distance + start * stride + end) = edge.weight;
+            *(neighbour + start * stride + end) = edge.hop;
         }
     }
+}
+
+/*
+ * Runs Floyd Warshall on a graph with V vertices, see initializeFloydWarshall. If keepDistance is given, it is set to
+ * the distances, otherwise they are freed.
+ */
+static spt_t floydWarshall(const world_t* world, const std::vector<int>* names, const int V, const std::vector<fwEdge_t>& edges, FWBackend backend, double** keepDistance)
+{
+    // Allocating Memory for the distance and optimal neighbour
+    const std::size_t elements = static_cast<std::size_t>(V) * V;
+    spt_t sopatree = {
+        .array = new int[elements],
+        .size = V,
+    };
 
+    int size = sopatree.size;
+    double *distance = (double*)malloc(elements * sizeof(double));
+    int *neighbour = sopatree.array;
+    initializeFloydWarshall(world, names, V, edges, distance, neighbour, static_cast<std::size_t>(V));
+
+    switch (backend) {
+        case FWBackend::CudaFW:
+#ifdef USE_CUDA
+            FloydWarshal(distance, neighbour, size);
+            break;
+#else
+            std::cerr << "Compiled without USE_CUDA, using the cpu implementation of Floyd Warshall" << std::endl;
+            FloydWarshalBlocked(distance, neighbour, size);
+            break;
+#endif
+        case FWBackend::BlockedFW:
+            FloydWarshalBlocked(distance, neighbour, size);
+            break;
+        case FWBackend::NaiveFW:
+            FloydWarshalNaive(distance, neighbour, size);
+            break;
+    }
     std::cout << std::endl;
-    int V = sopatree.size;
-    float newDistance;
-    for (int32_t k = 0; k < sopatree.size; k++) {
-#ifdef SLURM_OUTPUT
-        std::cout << "k: " << (k + 1) << " of " << V << std::cout;
+
+    if (keepDistance != nullptr) {
+        *keepDistance = distance;
+    }
+    else {
+        free(distance);
+    }
+    return sopatree;
+}
+
+// Compute Floyd-Warshal on entire graph to find the shortest path from a to b.
+spt_t calculateShortestPathTree(const world_t* world, const std::vector<StreetTypes>& include, FWBackend backend, bool keepDistance)
+{
+    const std::size_t V = world->intersections.size();
+    double* distance = nullptr;
+    spt_t sopatree = floydWarshall(world, nullptr, static_cast<int>(V), streetEdges(world, include), backend, keepDistance ? &distance : nullptr);
+    if (keepDistance) {
+        sopatree.distance = new float[V * V];
+        std::copy(distance, distance + V * V, sopatree.distance);
+        free(distance);
+    }
+    return sopatree;
+}
+
+void calculateShortestPathTrees(const world_t* world, spt_t* carTree, spt_t* bikeTree, FWBackend backend, bool keepDistance)
+{
+    const std::vector<StreetTypes> include[2] = {{StreetTypes::Both, StreetTypes::OnlyCar}, {StreetTypes::Both, StreetTypes::OnlyBike}};
+    if (backend == FWBackend::NaiveFW) {
+        *carTree = calculateShortestPathTree(world, include[0], backend, keepDistance);
+        *bikeTree = calculateShortestPathTree(world, include[1], backend, keepDistance);
+        return;
+    }
+
+    // Rows of both graphs interleaved, row i of the car graph is at 2 * i * size, row i of the bike graph after it.
+    const std::size_t size = world->intersections.size();
+    const std::size_t elements = size * size;
+    double* distance = (double*)malloc(2 * elements * sizeof(double));
+    int* neighbour = new int[2 * elements];
+
+    for (std::size_t lane = 0; lane < 2; lane++) {
+        initializeFloydWarshall(world, nullptr, static_cast<int>(size), streetEdges(world, include[lane]), distance + lane * size, neighbour + lane * size, 2 * size);
+    }
+
+#ifdef USE_CUDA
+    if (backend == FWBackend::CudaFW) {
+        FloydWarshalPair(distance, neighbour, static_cast<int>(size));
+    }
+    else {
+        FloydWarshalBlockedPair(distance, neighbour, static_cast<int>(size));
+    }
 #else
-        std::cout << "\rk: " << (k + 1) << " of " << V << std::flush;
+    if (backend == FWBackend::CudaFW) {
+        std::cerr << "Compiled without USE_CUDA, using the cpu implementation of Floyd Warshall" << std::endl;
+    }
+    FloydWarshalBlockedPair(distance, neighbour, static_cast<int>(size));
 #endif
+    std::cout << std::endl;
 
-        for (int32_t i = 0; i < sopatree.size; i++) {
+    carTree->size = static_cast<int>(size);
+    bikeTree->size = static_cast<int>(size);
+    carTree->array = new int[elements];
+    bikeTree->array = new int[elements];
+    carTree->distance = keepDistance ? new float[elements] : nullptr;
+    bikeTree->distance = keepDistance ? new float[elements] : nullptr;
 
-            for (int32_t j = 0; j < sopatree.size; j++) {
-                newDistance = minimumDistance[i * sopatree.size + k] + minimumDistance[k * sopatree.size + j];
-                sopatree.array[i * V + j] = sopatree.array[i * V + k] * (newDistance < minimumDistance[i * V + j]) + sopatree.array[i * V + j] * (newDistance >= minimumDistance[i * V + j]);
-                minimumDistance[i * V + j] = newDistance * (newDistance < minimumDistance[i * V + j]) + minimumDistance[i * V + j] * (newDistance >= minimumDistance[i * V + j]);
+    #pragma omp parallel for schedule(static) default(none) shared(neighbour, distance, carTree, bikeTree, size, keepDistance)
+    for (std::size_t row = 0; row < size; row++) {
+        std::copy(neighbour + 2 * row * size, neighbour + (2 * row + 1) * size, carTree->array + row * size);
+        std::copy(neighbour + (2 * row + 1) * size, neighbour + (2 * row + 2) * size, bikeTree->array + row * size);
+        if (keepDistance) {
+            std::copy(distance + 2 * row * size, distance + (2 * row + 1) * size, carTree->distance + row * size);
+            std::copy(distance + (2 * row + 1) * size, distance + (2 * row + 2) * size, bikeTree->distance + row * size);
+        }
+    }
+    free(distance);
+    delete[] neighbour;
+}
 
-            }
+spt_t calculateShortestPathTreeOutOfCore(const world_t* world, const std::vector<StreetTypes>& include, const char* scratch, bool destinationMajor)
+{
+    spt_t sopatree = {.array = nullptr, .size = static_cast<int>(world->intersections.size())};
+    std::vector<int> from;
+    std::vector<int> to;
+    std::vector<double> weight;
+    std::vector<std::pair<int, int>> pairs;
+    for (const auto& street : world->streets) {
+        if (std::find(include.begin(), include.end(), street.type) != include.end()) {
+            from.push_back(street.start);
+            to.push_back(street.end);
+            weight.push_back(streetWeight(street));
+            pairs.emplace_back(street.start, street.end);
         }
     }
+    std::sort(pairs.begin(), pairs.end());
+    for (std::size_t p = 1; p < pairs.size(); p++) {
+        if (pairs[p] == pairs[p - 1]) {
+            std::cout << "Road twice in graph" << std::endl;
+            std::cout << "Start: " << world->int_to_string.at(pairs[p].first) << " End: " << world->int_to_string.at(pairs[p].second) << std::endl;
+        }
+    }
+
+    // The file is unlinked right away, its blocks are freed once the tree is unmapped.
+    const std::string treeFile = std::string(scratch) + ".tree";
+    const std::size_t bytes = static_cast<std::size_t>(sopatree.size) * sopatree.size * sizeof(int);
+    int fd = open(treeFile.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1 || ftruncate(fd, bytes) != 0) {
+        std::cerr << "Failed to create " << treeFile << std::endl;
+        if (fd != -1) {
+            close(fd);
+        }
+        return sopatree;
+    }
+    void* mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    unlink(treeFile.c_str());
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map " << treeFile << std::endl;
+        return sopatree;
+    }
+
+    if (!FloydWarshalOutOfCore(scratch, sopatree.size, from.data(), to.data(), weight.data(), from.size(), static_cast<int*>(mapping), destinationMajor)) {
+        munmap(mapping, bytes);
+        return sopatree;
+    }
+    sopatree.array = static_cast<int*>(mapping);
+    sopatree.mapping = mapping;
+    sopatree.mappingSize = bytes;
+    sopatree.destinationMajor = destinationMajor;
     return sopatree;
 }
-#else
 
-spt_t calculateShortestPathTree(const world_t* world, const std::vector<StreetTypes>& include)
+chains_t* contractChains(const world_t* world, const std::vector<StreetTypes>& include)
 {
-    // Allocating Memory for the distance and optimal neighbour
+    const int V = static_cast<int>(world->intersections.size());
+
+    // Distinct neighbours of every intersection with the weight of the shortest street to or from them.
+    std::vector<std::map<int, double>> out(V);
+    std::vector<std::map<int, double>> in(V);
+    std::vector<bool> selfLoop(V, false);
+    for (const auto& street : world->streets) {
+        if (std::find(include.begin(), include.end(), street.type) == include.end()) {
+            continue;
+        }
+        if (street.start == street.end) {
+            selfLoop[street.start] = true;
+            continue;
+        }
+        const double weight = streetWeight(street);
+        auto iter = out[street.start].find(street.end);
+        if (iter == out[street.start].end() || weight < iter->second) {
+            out[street.start][street.end] = weight;
+            in[street.end][street.start] = weight;
+        }
+    }
+
+    // Streets of length zero are not contracted, a path could turn around on them forever.
+    std::vector<bool> inChain(V, false);
+    std::vector<bool> twoWay(V, false);
+    for (int v = 0; v < V; v++) {
+        if (selfLoop[v]) {
+            continue;
+        }
+        bool positive = true;
+        for (const auto& [neighbour, weight] : out[v]) {
+            positive = positive && weight > 0.0;
+        }
+        for (const auto& [neighbour, weight] : in[v]) {
+            positive = positive && weight > 0.0;
+        }
+
+        const bool oneWay = out[v].size() == 1 && in[v].size() == 1 && out[v].begin()->first != in[v].begin()->first;
+        twoWay[v] = out[v].size() == 2 && in[v].size() == 2
+            && out[v].begin()->first == in[v].begin()->first && out[v].rbegin()->first == in[v].rbegin()->first;
+        inChain[v] = positive && (oneWay || twoWay[v]);
+    }
+
+    chains_t* chains = new chains_t();
+    chains->chain = std::vector<int>(V, -1);
+    chains->forwardNext = std::vector<int>(V, -1);
+    chains->backwardNext = std::vector<int>(V, -1);
+    chains->fromStart = std::vector<double>(V, 1e30);
+    chains->toEnd = std::vector<double>(V, 1e30);
+    chains->fromEnd = std::vector<double>(V, 1e30);
+    chains->toStart = std::vector<double>(V, 1e30);
+
+    // Walks the chain which starts with the street u -> x.
+    auto walk = [&](const int u, const int x) {
+        const int id = static_cast<int>(chains->start.size());
+        std::vector<int> vertices;
+        int prev = u;
+        int cur = x;
+        while (inChain[cur] && chains->chain[cur] == -1) {
+            chains->chain[cur] = id;
+            vertices.push_back(cur);
+            int next = out[cur].begin()->first;
+            if (next == prev) {
+                next = out[cur].rbegin()->first;
+            }
+            prev = cur;
+            cur = next;
+        }
+        assert(!inChain[cur] && "A chain has to end at an intersection of the reduced graph");
+
+        const int L = static_cast<int>(vertices.size());
+        chains->start.push_back(u);
+        chains->end.push_back(cur);
+        chains->first.push_back(vertices.front());
+        chains->last.push_back(vertices.back());
+        chains->twoWay.push_back(twoWay[x]);
+
+        for (int i = 0; i < L; i++) {
+            const int v = vertices[i];
+            const int before = (i == 0) ? u : vertices[i - 1];
+            const int after = (i == L - 1) ? cur : vertices[i + 1];
+            chains->forwardNext[v] = after;
+            chains->fromStart[v] = ((i == 0) ? 0.0 : chains->fromStart[before]) + out[before].at(v);
+            if (twoWay[x]) {
+                chains->backwardNext[v] = before;
+                chains->toStart[v] = out[v].at(before) + ((i == 0) ? 0.0 : chains->toStart[before]);
+            }
+        }
+        for (int i = L - 1; i >= 0; i--) {
+            const int v = vertices[i];
+            const int after = (i == L - 1) ? cur : vertices[i + 1];
+            chains->toEnd[v] = out[v].at(after) + ((i == L - 1) ? 0.0 : chains->toEnd[after]);
+            if (twoWay[x]) {
+                chains->fromEnd[v] = ((i == L - 1) ? 0.0 : chains->fromEnd[after]) + out[after].at(v);
+            }
+        }
+    };
+
+    for (int u = 0; u < V; u++) {
+        if (inChain[u]) {
+            continue;
+        }
+        for (const auto& [x, weight] : out[u]) {
+            if (inChain[x] && chains->chain[x] == -1) {
+                walk(u, x);
+            }
+        }
+    }
+
+    // The remaining chain intersections are on cycles, keep one of each cycle in the reduced graph.
+    for (int v = 0; v < V; v++) {
+        if (inChain[v] && chains->chain[v] == -1) {
+            inChain[v] = false;
+            for (const auto& [x, weight] : out[v]) {
+                if (inChain[x] && chains->chain[x] == -1) {
+                    walk(v, x);
+                }
+            }
+        }
+    }
+
+    chains->reduced = std::vector<int>(V, -1);
+    for (int v = 0; v < V; v++) {
+        if (!inChain[v]) {
+            chains->reduced[v] = static_cast<int>(chains->core.size());
+            chains->core.push_back(v);
+        }
+    }
+    return chains;
+}
+
+spt_t calculateContractedShortestPathTree(const world_t* world, const std::vector<StreetTypes>& include, FWBackend backend)
+{
+    chains_t* chains = contractChains(world, include);
+    const int R = static_cast<int>(chains->core.size());
+
+    // Streets between intersections of the reduced graph and the chains starting at them.
+    std::vector<fwEdge_t> edges;
+    for (const auto& street : world->streets) {
+        if (std::find(include.begin(), include.end(), street.type) == include.end()) {
+            continue;
+        }
+        const int u = street.start;
+        const int x = street.end;
+        if (chains->reduced[u] == -1 || u == x) {
+            continue;
+        }
+        if (chains->reduced[x] != -1) {
+            edges.push_back({chains->reduced[u], chains->reduced[x], x, streetWeight(street)});
+            continue;
+        }
+
+        const int c = chains->chain[x];
+        const double total = (u == chains->start[c]) ? chains->fromStart[x] + chains->toEnd[x] : chains->fromEnd[x] + chains->toStart[x];
+        const int target = (u == chains->start[c]) ? chains->end[c] : chains->start[c];
+        if (target != u) {
+            edges.push_back({chains->reduced[u], chains->reduced[target], x, total});
+        }
+    }
+
+    std::cout << "Contracted " << chains->start.size() << " chains, Floyd Warshall runs on " << R << " of "
+              << world->intersections.size() << " intersections" << std::endl;
+
+    double* distance = nullptr;
+    chains->tree = floydWarshall(world, &chains->core, R, edges, backend, &distance);
+    chains->distance = new float[static_cast<std::size_t>(R) * R];
+    std::copy(distance, distance + static_cast<std::size_t>(R) * R, chains->distance);
+    free(distance);
+
     spt_t sopatree = {
-        .array = new int[world->intersections.size() * world->intersections.size()],
+        .array = nullptr,
         .size = static_cast<int>(world->intersections.size()),
     };
+    sopatree.chains = chains;
+    return sopatree;
+}
 
-    int size = sopatree.size;
-    double *distance = (double*)malloc(size * size * sizeof(double));
-    int *neighbour = sopatree.array;
+/*
+ * Returns the transposed copy of the n x n matrix and deletes the original.
+ */
+template <typename T>
+static T* transposeMatrix(T* matrix, const std::size_t n)
+{
+    const std::size_t B = 64;
+    T* transposed = new T[n * n];
 
-    // Initialize the distance and neighbour arrays
-    for (int start = 0; start < size; start++) {
-        for (int end = 0; end < size; end++) {
-            *(distance + start * size + end) = (start != end) * 1e30; // Initializing the default distance between nodes
-            *(neighbour + start * size + end) = (start == end) * start + (start != end) * -1; // Initializing the default neighbour
+    // Tiled, so both the rows read and the rows written stay in the cache.
+    #pragma omp parallel for collapse(2) schedule(static) default(none) shared(matrix, transposed, n, B)
+    for (std::size_t i0 = 0; i0 < n; i0 += B) {
+        for (std::size_t j0 = 0; j0 < n; j0 += B) {
+            for (std::size_t i = i0; i < std::min(i0 + B, n); i++) {
+                for (std::size_t j = j0; j < std::min(j0 + B, n); j++) {
+                    transposed[j * n + i] = matrix[i * n + j];
+                }
+            }
         }
     }
 
-    // Add Distance of Streets to the distance array
+    delete[] matrix;
+    return transposed;
+}
+
+void transposeShortestPathTree(spt_t* spt)
+{
+    if (spt->chains != nullptr) {
+        transposeShortestPathTree(&spt->chains->tree);
+        spt->chains->distance = transposeMatrix(spt->chains->distance, spt->chains->tree.size);
+        spt->destinationMajor = spt->chains->tree.destinationMajor;
+        return;
+    }
+    assert(spt->array != nullptr && spt->column == nullptr && "Only full trees with intersection ids can be transposed");
+    spt->array = transposeMatrix(spt->array, spt->size);
+    if (spt->distance != nullptr) {
+        spt->distance = transposeMatrix(spt->distance, spt->size);
+    }
+    spt->destinationMajor = !spt->destinationMajor;
+}
+
+/*
+ * The distinct outbound neighbours of every intersection, sorted so the slots don't depend on the street order.
+ */
+static std::vector<std::vector<int>> outboundNeighbours(const world_t* world, const std::vector<StreetTypes>& include)
+{
+    std::vector<std::vector<int>> adjacency(world->intersections.size());
     for (const auto& street : world->streets) {
         if (std::find(include.begin(), include.end(), street.type) != include.end()) {
-            int start = street.start;
-            int end = street.end;
-            // Take the shortest street in case there are multiple (for what ever reason there should be multiple
-#ifdef ALTFW
-            double streetDistance = street.length / (street.speedlimit * street.width);
-#else
-            double streetDistance = street.length;
-#endif
-            if (*(distance + start * size + end) < 1e30) {
-                std::cout << "Road twice in graph" << std::endl;
-                std::cout << "Start: " << world->int_to_string.at(start) << " End: " << world->int_to_string.at(end) << std::endl;
+            adjacency[street.start].push_back(street.end);
+        }
+    }
+    for (auto& neighbours : adjacency) {
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+    }
+    return adjacency;
+}
+
+/*
+ * The bits per slot for the given neighbour lists, 0 if an intersection has too many. The largest slot is reserved for
+ * unreachable destinations.
+ */
+static int slotBits(const std::vector<std::vector<int>>& adjacency)
+{
+    std::size_t maxDegree = 0;
+    for (const auto& neighbours : adjacency) {
+        maxDegree = std::max(maxDegree, neighbours.size());
+    }
+    if (maxDegree < 16) {
+        return 4;
+    }
+    if (maxDegree < 256) {
+        return 8;
+    }
+    return 0;
+}
+
+int neighbourSlotBits(const world_t* world, const std::vector<StreetTypes>& include)
+{
+    return slotBits(outboundNeighbours(world, include));
+}
+
+bool encodeNeighbourSlots(const world_t* world, const std::vector<StreetTypes>& include, const spt_t* tree, spt_t* encoded)
+{
+    if (tree->array == nullptr || tree->column != nullptr) {
+        std::cerr << "Only full shortest path trees can be encoded with neighbour slots" << std::endl;
+        return false;
+    }
+
+    const int V = tree->size;
+    const std::vector<std::vector<int>> adjacency = outboundNeighbours(world, include);
+    const int bits = slotBits(adjacency);
+    if (bits == 0) {
+        std::cerr << "An intersection has too many neighbours for neighbour slots" << std::endl;
+        return false;
+    }
+
+    encoded->array = nullptr;
+    encoded->size = V;
+    encoded->column = nullptr;
+    encoded->slotBits = bits;
+    encoded->destinationMajor = tree->destinationMajor;
+    encoded->rowBytes = (static_cast<std::size_t>(V) * bits + 7) / 8;
+    encoded->slots = new unsigned char[V * encoded->rowBytes];
+    encoded->neighbourOffset = new int[V + 1];
+    encoded->neighbourOffset[0] = 0;
+    for (int u = 0; u < V; u++) {
+        encoded->neighbourOffset[u + 1] = encoded->neighbourOffset[u] + static_cast<int>(adjacency[u].size());
+    }
+    encoded->neighbours = new int[encoded->neighbourOffset[V]];
+    for (int u = 0; u < V; u++) {
+        std::copy(adjacency[u].begin(), adjacency[u].end(), encoded->neighbours + encoded->neighbourOffset[u]);
+    }
+    encoded->distance = nullptr;
+    if (tree->distance != nullptr) {
+        encoded->distance = new float[static_cast<std::size_t>(V) * V];
+        std::copy(tree->distance, tree->distance + static_cast<std::size_t>(V) * V, encoded->distance);
+    }
+
+    const int unreachable = (1 << bits) - 1;
+    bool valid = true;
+
+    // Every row is padded to whole bytes, so the rows can be encoded in parallel.
+    #pragma omp parallel for schedule(static) default(none) shared(tree, encoded, adjacency, V, bits, unreachable) reduction(&&:valid)
+    for (int r = 0; r < V; r++) {
+        unsigned char* row = encoded->slots + r * encoded->rowBytes;
+        std::fill(row, row + encoded->rowBytes, 0);
+
+        for (int entry = 0; entry < V; entry++) {
+            const int u = tree->destinationMajor ? entry : r;
+            const int end = tree->destinationMajor ? r : entry;
+            const std::vector<int>& neighbours = adjacency[u];
+            const int next = nextHop(tree, u, end);
+            int slot = unreachable;
+            if (next != -1 && end != u) {
+                slot = static_cast<int>(std::lower_bound(neighbours.begin(), neighbours.end(), next) - neighbours.begin());
+                if (slot == static_cast<int>(neighbours.size()) || neighbours[slot] != next) {
+                    valid = false;
+                    slot = unreachable;
+                }
+            }
+            if (bits == 8) {
+                row[entry] = static_cast<unsigned char>(slot);
+            }
+            else {
+                row[entry >> 1] |= static_cast<unsigned char>(slot << ((entry & 1) << 2));
             }
-            *(distance + start * size + end) = std::min(streetDistance, *(distance + start * size + end));
-            *(neighbour + start * size + end) = end;
         }
     }
-    FloydWarshal(distance, neighbour, size);
-    std::cout << std::endl;
+
+    if (!valid) {
+        std::cerr << "The tree contains next hops which are not neighbours" << std::endl;
+    }
+    std::cout << "Encoded SPT with " << bits << " bits per next hop, " << V * encoded->rowBytes << " bytes" << std::endl;
+    return valid;
+}
+
+csr_t buildReverseGraph(const world_t* world, const std::vector<StreetTypes>& include, const std::vector<double>* weights)
+{
+    const std::size_t V = world->intersections.size();
+    csr_t graph;
+    graph.offset = std::vector<int>(V + 1, 0);
+
+    // Count the inbound streets per intersection, then turn the counts into offsets.
+    for (const auto& street : world->streets) {
+        if (std::find(include.begin(), include.end(), street.type) != include.end()) {
+            graph.offset[street.end + 1]++;
+        }
+    }
+    for (std::size_t v = 0; v < V; v++) {
+        graph.offset[v + 1] += graph.offset[v];
+    }
+
+    graph.target = std::vector<int>(graph.offset[V]);
+    graph.weight = std::vector<double>(graph.offset[V]);
+    std::vector<int> fill(graph.offset.begin(), graph.offset.end() - 1);
+
+    for (std::size_t i = 0; i < world->streets.size(); i++) {
+        const Street& street = world->streets[i];
+        if (std::find(include.begin(), include.end(), street.type) != include.end()) {
+            const int edge = fill[street.end]++;
+            graph.target[edge] = street.start;
+            graph.weight[edge] = (weights != nullptr) ? weights->at(i) : streetWeight(street);
+        }
+    }
+    return graph;
+}
+
+void reverseDijkstra(const csr_t& graph, const int destination, int* next, double* distance)
+{
+    const int V = static_cast<int>(graph.offset.size()) - 1;
+    for (int v = 0; v < V; v++) {
+        next[v] = -1;
+        distance[v] = 1e30;
+    }
+
+    typedef std::pair<double, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<>> queue;
+    next[destination] = destination;
+    distance[destination] = 0.0;
+    queue.emplace(0.0, destination);
+
+    while (!queue.empty()) {
+        const auto [d, v] = queue.top();
+        queue.pop();
+
+        // Stale entry, v has been settled with a shorter distance already.
+        if (d > distance[v]) {
+            continue;
+        }
+
+        // Every edge of the reversed graph is a street u -> v, so v is the next hop of u.
+        for (int edge = graph.offset[v]; edge < graph.offset[v + 1]; edge++) {
+            const int u = graph.target[edge];
+            const double newDistance = d + graph.weight[edge];
+            if (newDistance < distance[u]) {
+                distance[u] = newDistance;
+                next[u] = v;
+                queue.emplace(newDistance, u);
+            }
+        }
+    }
+}
+
+spt_t calculateDestinationTrees(const world_t* world, const std::vector<StreetTypes>& include, const std::vector<int>& destinations, const std::vector<double>* weights)
+{
+    const int V = static_cast<int>(world->intersections.size());
+    spt_t sopatree = {
+        .array = nullptr,
+        .size = V,
+        .column = new int[V],
+    };
+    std::fill(sopatree.column, sopatree.column + V, -1);
+
+    // Assign a column to every distinct destination.
+    std::vector<int> columns;
+    for (const int end : destinations) {
+        if (end >= 0 && end < V && sopatree.column[end] == -1) {
+            sopatree.column[end] = static_cast<int>(columns.size());
+            columns.push_back(end);
+        }
+    }
+    sopatree.array = new int[columns.size() * V];
+    sopatree.distance = new float[columns.size() * V];
+
+    const csr_t graph = buildReverseGraph(world, include, weights);
+    const int n = static_cast<int>(columns.size());
+
+    #pragma omp parallel default(none) shared(graph, columns, sopatree, n, V)
+    {
+        std::vector<double> distance(V);
+
+        #pragma omp for schedule(dynamic, 16)
+        for (int c = 0; c < n; c++) {
+            reverseDijkstra(graph, columns[c], sopatree.array + static_cast<std::size_t>(c) * V, distance.data());
+            std::copy(distance.begin(), distance.end(), sopatree.distance + static_cast<std::size_t>(c) * V);
+        }
+    }
+    std::cout << "Computed " << n << " destination trees of " << V << " intersections" << std::endl;
     return sopatree;
 }
 
-#endif
+std::vector<double> congestedStreetWeights(const world_t* world)
+{
+    std::vector<double> weights(world->streets.size());
+    for (std::size_t i = 0; i < world->streets.size(); i++) {
+        const Street& street = world->streets[i];
+        const double freeFlow = street.speedlimit; // m/s
+        double velocity = freeFlow;
+        if (!street.traffic.empty()) {
+            double sum = 0.0;
+            for (const Actor* actor : street.traffic) {
+                sum += actor->current_velocity;
+            }
+            velocity = std::clamp(sum / static_cast<double>(street.traffic.size()), REROUTE_MIN_VELOCITY, std::max(freeFlow, REROUTE_MIN_VELOCITY));
+        }
+        weights[i] = street.length / velocity;
+    }
+    return weights;
+}
 
-Path retrievePath(spt_t* spt, const int &start, const int &end)
+std::vector<double> experiencedStreetWeights(const world_t* world, const float timeDelta)
 {
-    if (spt->array[start * spt->size + end] == -1) {
-        return {};
+    std::vector<double> weights(world->streets.size());
+    for (std::size_t i = 0; i < world->streets.size(); i++) {
+        const Street& street = world->streets[i];
+        const double entered = static_cast<double>(street.total_traffic_count_car + street.total_traffic_count_bike);
+        if (entered == 0.0) {
+            weights[i] = street.length / static_cast<double>(street.speedlimit); // Free flow, like congestedStreetWeights
+            continue;
+        }
+        // The accumulators sum actors per meter every time step, i.e. the mean occupancy times the number of steps.
+        const double actorSeconds = (street.density_accumulate_car + street.density_accumulate_bike) * street.length * timeDelta;
+        weights[i] = actorSeconds / entered;
     }
+    return weights;
+}
 
-    Path p;
+spt_t updateDestinationTrees(const world_t* world, const std::vector<StreetTypes>& include, const spt_t* tree, const std::vector<double>& before, const std::vector<double>& after, int* recomputed)
+{
+    assert(tree->column != nullptr && tree->distance != nullptr && "Only demand driven trees with distances can be updated");
+    const std::size_t V = tree->size;
+    std::vector<int> columns;
+    for (std::size_t end = 0; end < V; end++) {
+        if (tree->column[end] != -1) {
+            columns.push_back(static_cast<int>(end));
+        }
+    }
+    const std::size_t n = columns.size();
+    spt_t updated = {
+        .array = new int[n * V],
+        .size = tree->size,
+        .column = new int[V],
+    };
+    updated.distance = new float[n * V];
+    std::copy(tree->column, tree->column + V, updated.column);
 
-    int u = start;
-//    p.push(u);
-    while (u != end) {
-        assert(u < spt->size && "Overflow of the spt array");
-        assert(p.size() < spt->size && "Overflow of the path array" && "Overflow of the spt array");
-        if (u == -1) {
-            return {};
+    std::vector<std::size_t> changed;
+    for (std::size_t i = 0; i < world->streets.size(); i++) {
+        if (after[i] != before[i] && std::find(include.begin(), include.end(), world->streets[i].type) != include.end()) {
+            changed.push_back(i);
         }
-        u = spt->array[u * spt->size + end];
-        p.push(u);
     }
-    return p;
+
+    const csr_t graph = buildReverseGraph(world, include, &after);
+    int count = 0;
+
+    #pragma omp parallel default(none) shared(world, tree, after, before, changed, columns, updated, graph, n, V) reduction(+:count)
+    {
+        std::vector<double> distance(V);
+
+        #pragma omp for schedule(dynamic, 16)
+        for (std::size_t c = 0; c < n; c++) {
+            const std::size_t offset = static_cast<std::size_t>(tree->column[columns[c]]) * V;
+            const int* next = tree->array + offset;
+            const float* old = tree->distance + offset;
+
+            // The distances are floats, so only improvements beyond their precision count.
+            bool affected = false;
+            for (const std::size_t i : changed) {
+                const Street& street = world->streets[i];
+                if ((after[i] > before[i] && next[street.start] == street.end && street.start != columns[c])
+                    || (old[street.end] < 1e30 && after[i] + old[street.end] < old[street.start] * (1.0 - 1e-6))) {
+                    affected = true;
+                    break;
+                }
+            }
+
+            if (affected) {
+                reverseDijkstra(graph, columns[c], updated.array + c * V, distance.data());
+                std::copy(distance.begin(), distance.end(), updated.distance + c * V);
+                count++;
+            }
+            else {
+                std::copy(next, next + V, updated.array + c * V);
+                std::copy(old, old + V, updated.distance + c * V);
+            }
+        }
+    }
+    // The columns of the updated tree are in the order of the destinations.
+    for (std::size_t c = 0; c < n; c++) {
+        updated.column[columns[c]] = static_cast<int>(c);
+    }
+
+    if (recomputed != nullptr) {
+        *recomputed = count;
+    }
+    return updated;
 }
 
-float distanceFromPath(const world_t* world, actor_t* actor)
+std::vector<int> activeDestinations(const world_t* world, const ActorTypes type)
 {
-    Path p;
+    std::vector<int> destinations;
+    for (const Actor* actor : world->actors) {
+        if (actor != nullptr && actor->type == type && !actor->arrived && actor->path.tree != nullptr && !pathEmpty(&actor->path)) {
+            destinations.push_back(actor->end_id);
+        }
+    }
+    return destinations;
+}
 
-    // Initialize the path
-    int u = actor->start_id;
-    int v = actor->path.front();
-    float distance = 0.0f;
-    Street* street = nullptr;
+void rerouteActors(world_t* world, const spt_t* carsSPT, const spt_t* bikeSPT)
+{
+    for (Actor* actor : world->actors) {
+        if (actor != nullptr && !actor->arrived && actor->path.tree != nullptr && !pathEmpty(&actor->path)) {
+            actor->path.tree = (actor->type == ActorTypes::Bike) ? bikeSPT : carsSPT;
+        }
+    }
 
-    // Walk along the Path
-    while (v != actor->end_id) {
-        p.push(v);
-        actor->path.pop();
+    // Actors on a street have to drive to its end, from there they take the next hop of the new tree.
+    for (const Street& street : world->streets) {
+        for (Actor* actor : street.traffic) {
+            if (actor->path.tree != nullptr && !pathEmpty(&actor->path) && street.end != actor->path.end) {
+                actor->path.next = nextHop(actor->path.tree, street.end, actor->path.end);
+            }
+        }
+    }
 
-        if (actor->type == ActorTypes::Bike) {
-            street = world->intersections.at(u).outboundBike.at(v);
+    // Waiting actors haven't entered the street to their next intersection yet, so they can still take another one.
+    for (const Intersection& intersection : world->intersections) {
+        for (Actor* actor : intersection.waitingToBeInserted) {
+            if (!actor->Teleport && actor->path.tree != nullptr && !pathEmpty(&actor->path)) {
+                actor->path.next = nextHop(actor->path.tree, intersection.id, actor->path.end);
+            }
+        }
+    }
+}
+
+/*
+ * Weight of the shortest street between every pair of connected intersections, like Floyd Warshall sees the graph.
+ */
+static std::map<std::pair<int, int>, double> edgeWeights(const world_t* world, const std::vector<StreetTypes>& include)
+{
+    std::map<std::pair<int, int>, double> weights;
+    for (const auto& street : world->streets) {
+        if (std::find(include.begin(), include.end(), street.type) == include.end()) {
+            continue;
+        }
+        auto [iter, inserted] = weights.emplace(std::make_pair(street.start, street.end), streetWeight(street));
+        if (!inserted) {
+            iter->second = std::min(iter->second, streetWeight(street));
+        }
+    }
+    return weights;
+}
+
+spt_t expandShortestPathTree(const spt_t* tree)
+{
+    const std::size_t V = tree->size;
+    spt_t expanded = {
+        .array = new int[V * V],
+        .size = tree->size,
+    };
+
+    #pragma omp parallel for schedule(static) default(none) shared(tree, expanded, V)
+    for (std::size_t u = 0; u < V; u++) {
+        for (std::size_t end = 0; end < V; end++) {
+            expanded.array[u * V + end] = nextHop(tree, static_cast<int>(u), static_cast<int>(end));
+        }
+    }
+    return expanded;
+}
+
+double* shortestPathDistances(const world_t* world, const std::vector<StreetTypes>& include, const spt_t* tree)
+{
+    assert(tree->array != nullptr && tree->column == nullptr && !tree->destinationMajor && "Only full source-major trees with intersection ids have distances");
+    const std::size_t V = tree->size;
+    std::vector<std::vector<std::pair<int, double>>> out(V);
+    for (const auto& [edge, weight] : edgeWeights(world, include)) {
+        out[edge.first].emplace_back(edge.second, weight);
+    }
+    double* distance = new double[V * V];
+
+    #pragma omp parallel default(none) shared(tree, out, distance, V)
+    {
+        std::vector<double> column(V);
+        std::vector<int> walked;
+
+        #pragma omp for schedule(dynamic, 16)
+        for (std::size_t end = 0; end < V; end++) {
+            std::fill(column.begin(), column.end(), -1.0);
+            column[end] = 0.0;
+
+            // Walk towards end until an intersection with a known distance, then fill in the walked ones backwards.
+            for (std::size_t start = 0; start < V; start++) {
+                int u = static_cast<int>(start);
+                while (column[u] < 0.0) {
+                    const int v = tree->array[u * V + end];
+                    if (v == -1) {
+                        column[u] = 1e30;
+                        break;
+                    }
+                    walked.push_back(u);
+                    u = v;
+                }
+                double d = column[u];
+                while (!walked.empty()) {
+                    const int w = walked.back();
+                    const int v = tree->array[w * V + end];
+                    walked.pop_back();
+                    const auto edge = std::find_if(out[w].begin(), out[w].end(), [v](const auto& e) { return e.first == v; });
+                    assert(edge != out[w].end() && "Next hop of the tree is not a neighbour");
+                    d = (d < 1e30) ? d + edge->second : 1e30;
+                    column[w] = d;
+                }
+            }
+            for (std::size_t start = 0; start < V; start++) {
+                distance[start * V + end] = column[start];
+            }
+        }
+    }
+    return distance;
+}
+
+std::vector<edgeChange_t> findEdgeChanges(const world_t* before, const world_t* after, const std::vector<StreetTypes>& include)
+{
+    const auto weightsBefore = edgeWeights(before, include);
+    const auto weightsAfter = edgeWeights(after, include);
+    std::vector<edgeChange_t> changes;
+
+    for (const auto& [edge, weight] : weightsBefore) {
+        const auto iter = weightsAfter.find(edge);
+        const double newWeight = (iter == weightsAfter.end()) ? 1e30 : iter->second;
+        if (newWeight != weight) {
+            changes.push_back({edge.first, edge.second, weight, newWeight});
+        }
+    }
+    for (const auto& [edge, weight] : weightsAfter) {
+        if (weightsBefore.find(edge) == weightsBefore.end()) {
+            changes.push_back({edge.first, edge.second, 1e30, weight});
+        }
+    }
+    return changes;
+}
+
+/*
+ * Compressed sparse row adjacency of the given edge weights. With reverse the edges of v are the streets u -> v and
+ * target holds u, like in buildReverseGraph, otherwise they are the streets v -> u.
+ */
+static csr_t edgeGraph(const std::map<std::pair<int, int>, double>& weights, const std::size_t V, const bool reverse)
+{
+    csr_t graph;
+    graph.offset = std::vector<int>(V + 1, 0);
+    for (const auto& [edge, weight] : weights) {
+        graph.offset[(reverse ? edge.second : edge.first) + 1]++;
+    }
+    for (std::size_t v = 0; v < V; v++) {
+        graph.offset[v + 1] += graph.offset[v];
+    }
+    graph.target = std::vector<int>(graph.offset[V]);
+    graph.weight = std::vector<double>(graph.offset[V]);
+    std::vector<int> fill(graph.offset.begin(), graph.offset.end() - 1);
+    for (const auto& [edge, weight] : weights) {
+        const int e = fill[reverse ? edge.second : edge.first]++;
+        graph.target[e] = reverse ? edge.first : edge.second;
+        graph.weight[e] = weight;
+    }
+    return graph;
+}
+
+std::size_t updateShortestPathTree(const world_t* world, const std::vector<StreetTypes>& include, spt_t* tree, double* distance, const std::vector<edgeChange_t>& changes)
+{
+    assert(tree->array != nullptr && tree->column == nullptr && !tree->destinationMajor && "Only full source-major trees with intersection ids can be updated");
+    const std::size_t V = tree->size;
+    int* next = tree->array;
+    std::vector<edgeChange_t> longer;
+    std::vector<edgeChange_t> shorter;
+    for (const auto& change : changes) {
+        if (change.after > change.before) {
+            longer.push_back(change);
+        }
+        else if (change.after < change.before) {
+            shorter.push_back(change);
+        }
+    }
+
+    // The repair runs on the graph with only the longer edges changed, so the whole matrix is exact for that graph
+    // before the shorter edges are relaxed.
+    auto weights = edgeWeights(world, include);
+    for (const auto& change : shorter) {
+        if (change.before < 1e30) {
+            weights[{change.start, change.end}] = change.before;
         }
         else {
-            street = world->intersections.at(u).outboundCar.at(v);
+            weights.erase({change.start, change.end});
+        }
+    }
+    const csr_t incoming = edgeGraph(weights, V, true);
+    const csr_t outgoing = edgeGraph(weights, V, false);
+
+    // A destination is only affected by a longer edge if its tree uses the edge, the other trees stay optimal.
+    std::vector<int> affected;
+    for (std::size_t end = 0; end < V; end++) {
+        for (const auto& change : longer) {
+            if (change.start != static_cast<int>(end) && next[change.start * V + end] == change.end) {
+                affected.push_back(static_cast<int>(end));
+                break;
+            }
         }
-        distance += street->length;
-        u = v;
-        v = actor->path.front();
     }
+    const int columns = static_cast<int>(affected.size());
+    std::size_t repaired = 0;
+
+    #pragma omp parallel default(none) shared(incoming, outgoing, longer, affected, next, distance, V, columns) reduction(+:repaired)
+    {
+        std::vector<char> state(V); // 0 not visited yet, 1 path is still optimal, 2 path uses a longer edge
+        std::vector<int> walked;
+        std::vector<int> subtree;
+        typedef std::pair<double, int> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<>> queue;
+
+        #pragma omp for schedule(dynamic, 16)
+        for (int c = 0; c < columns; c++) {
+            const std::size_t end = affected[c];
+            std::fill(state.begin(), state.end(), 0);
+            state[end] = 1;
+            for (const auto& change : longer) {
+                if (change.start != static_cast<int>(end) && next[change.start * V + end] == change.end) {
+                    state[change.start] = 2;
+                }
+            }
+
+            // Only the sources below the start of a longer edge in the tree of end use it. Walk towards end until an
+            // intersection whose state is known, the walked ones share it.
+            subtree.clear();
+            for (std::size_t start = 0; start < V; start++) {
+                int u = static_cast<int>(start);
+                while (state[u] == 0 && next[u * V + end] != -1) {
+                    walked.push_back(u);
+                    u = next[u * V + end];
+                }
+                const char s = (state[u] == 0) ? 1 : state[u];
+                state[u] = s;
+                for (const int w : walked) {
+                    state[w] = s;
+                }
+                walked.clear();
+                if (state[start] == 2) {
+                    subtree.push_back(static_cast<int>(start));
+                }
+            }
+
+            // Invalidate the subtree and settle it again with Dijkstra, starting from the best unaffected neighbours.
+            for (const int u : subtree) {
+                distance[u * V + end] = 1e30;
+                next[u * V + end] = -1;
+            }
+            for (const int u : subtree) {
+                for (int edge = outgoing.offset[u]; edge < outgoing.offset[u + 1]; edge++) {
+                    const int v = outgoing.target[edge];
+                    const double newDistance = outgoing.weight[edge] + distance[v * V + end];
+                    if (state[v] == 1 && distance[v * V + end] < 1e30 && newDistance < distance[u * V + end]) {
+                        distance[u * V + end] = newDistance;
+                        next[u * V + end] = v;
+                    }
+                }
+                if (next[u * V + end] != -1) {
+                    queue.emplace(distance[u * V + end], u);
+                }
+            }
+            while (!queue.empty()) {
+                const auto [d, v] = queue.top();
+                queue.pop();
+                if (d > distance[v * V + end]) {
+                    continue;
+                }
+                for (int edge = incoming.offset[v]; edge < incoming.offset[v + 1]; edge++) {
+                    const int u = incoming.target[edge];
+                    const double newDistance = d + incoming.weight[edge];
+                    if (state[u] == 2 && newDistance < distance[u * V + end]) {
+                        distance[u * V + end] = newDistance;
+                        next[u * V + end] = v;
+                        queue.emplace(newDistance, u);
+                    }
+                }
+            }
+            repaired += subtree.size();
+        }
+    }
+
+    // A shorter edge u -> v can only improve the paths from the sources which reach v faster through it to the
+    // destinations which are reached faster from u through it.
+    for (const auto& change : shorter) {
+        const std::size_t u = change.start;
+        const std::size_t v = change.end;
+        const double weight = change.after;
+        if (weight >= distance[u * V + v]) {
+            continue;
+        }
+        std::vector<std::size_t> rows;
+        std::vector<std::size_t> columns;
+        for (std::size_t i = 0; i < V; i++) {
+            if (distance[i * V + u] + weight < distance[i * V + v]) {
+                rows.push_back(i);
+            }
+        }
+        for (std::size_t j = 0; j < V; j++) {
+            if (weight + distance[v * V + j] < distance[u * V + j]) {
+                columns.push_back(j);
+            }
+        }
+
+        // Neither row v nor column u can be in the sets, so the rows are independent.
+        #pragma omp parallel for schedule(static) default(none) shared(rows, columns, next, distance, V, u, v, weight)
+        for (std::size_t r = 0; r < rows.size(); r++) {
+            const std::size_t i = rows[r];
+            const double toEdgeEnd = distance[i * V + u] + weight;
+            const int hop = (i == u) ? static_cast<int>(v) : next[i * V + u];
+            for (const std::size_t j : columns) {
+                const double newDistance = toEdgeEnd + distance[v * V + j];
+                if (newDistance < distance[i * V + j]) {
+                    distance[i * V + j] = newDistance;
+                    next[i * V + j] = hop;
+                }
+            }
+        }
+    }
+    return repaired;
+}
+
+// Route through a tree with contracted chains: leave the chain of the start at exit, follow the reduced tree to entry
+// and enter the chain of the end there. Direct routes stay inside the chain of start and end.
+typedef struct ChainRoute {
+    double cost;
+    int step; // First intersection after the start
+    int exit;
+    int entry;
+    int entryStep; // First intersection of the chain of the end after entry
+    bool direct;
+} chainRoute_t;
 
-    // Do the last iteration
-    p.push(v);
-    actor->path.pop();
+/*
+ * Distance between two intersections of the reduced graph, given as reduced indices.
+ */
+static inline double reducedDistance(const chains_t* chains, const int x, const int y)
+{
+    const std::size_t R = chains->tree.size;
+    return chains->tree.destinationMajor ? chains->distance[y * R + x] : chains->distance[x * R + y];
+}
+
+/*
+ * Finds the shortest of the at most four combinations of the ends of the chains of u and end. Both directions are
+ * only possible in two way chains.
+ */
+static chainRoute_t planChainRoute(const chains_t* chains, const int u, const int end)
+{
+    chainRoute_t best = {1e30, -1, -1, -1, -1, false};
+    const int uChain = chains->chain[u];
+    const int endChain = chains->chain[end];
 
-    if (actor->type == ActorTypes::Bike) {
-        street = world->intersections.at(u).outboundBike.at(v);
+    int exits[2];
+    int exitSteps[2];
+    double exitCosts[2];
+    int numExits = 0;
+    if (uChain == -1) {
+        exits[numExits] = u;
+        exitSteps[numExits] = -1;
+        exitCosts[numExits++] = 0.0;
     }
     else {
-        street = world->intersections.at(u).outboundCar.at(v);
+        exits[numExits] = chains->end[uChain];
+        exitSteps[numExits] = chains->forwardNext[u];
+        exitCosts[numExits++] = chains->toEnd[u];
+        if (chains->twoWay[uChain]) {
+            exits[numExits] = chains->start[uChain];
+            exitSteps[numExits] = chains->backwardNext[u];
+            exitCosts[numExits++] = chains->toStart[u];
+        }
     }
-    distance += street->length;
 
-    // Move the new path to the actor and hope the old path get's deleted
-    actor->path = p;
+    int entries[2];
+    int entrySteps[2];
+    double entryCosts[2];
+    int numEntries = 0;
+    if (endChain == -1) {
+        entries[numEntries] = end;
+        entrySteps[numEntries] = end;
+        entryCosts[numEntries++] = 0.0;
+    }
+    else {
+        entries[numEntries] = chains->start[endChain];
+        entrySteps[numEntries] = chains->first[endChain];
+        entryCosts[numEntries++] = chains->fromStart[end];
+        if (chains->twoWay[endChain]) {
+            entries[numEntries] = chains->end[endChain];
+            entrySteps[numEntries] = chains->last[endChain];
+            entryCosts[numEntries++] = chains->fromEnd[end];
+        }
+    }
 
-    return distance;
+    if (uChain != -1 && uChain == endChain) {
+        if (chains->fromStart[end] > chains->fromStart[u]) {
+            best = {chains->fromStart[end] - chains->fromStart[u], chains->forwardNext[u], -1, -1, -1, true};
+        }
+        else if (chains->twoWay[uChain]) {
+            best = {chains->fromEnd[end] - chains->fromEnd[u], chains->backwardNext[u], -1, -1, -1, true};
+        }
+    }
+
+    for (int i = 0; i < numExits; i++) {
+        for (int j = 0; j < numEntries; j++) {
+            const double between = (exits[i] == entries[j]) ? 0.0 : reducedDistance(chains, chains->reduced[exits[i]], chains->reduced[entries[j]]);
+            if (between >= 1e30) {
+                continue;
+            }
+            const double cost = exitCosts[i] + between + entryCosts[j];
+            if (cost < best.cost) {
+                int step = exitSteps[i];
+                if (uChain == -1) {
+                    step = (u == entries[j]) ? entrySteps[j] : nextHop(&chains->tree, chains->reduced[u], chains->reduced[entries[j]]);
+                }
+                best = {cost, step, exits[i], entries[j], entrySteps[j], false};
+            }
+        }
+    }
+    return best;
 }
 
-std::vector<std::string> getPath(actor_t* actor, const world_t* world)
+double contractedDistance(const chains_t* chains, const int u, const int end)
 {
-    std::vector<std::string> path;
-    Path replacement;
+    if (u == end) {
+        return 0.0;
+    }
+    if (chains->reduced[u] != -1 && chains->reduced[end] != -1) {
+        return reducedDistance(chains, chains->reduced[u], chains->reduced[end]);
+    }
+    return planChainRoute(chains, u, end).cost;
+}
 
-    int u = actor->start_id;
-    int v = actor->path.front();
-    path.push_back(world->int_to_string.at(u));
+int contractedNextHop(const chains_t* chains, const int u, const int end)
+{
+    if (u == end) {
+        return u;
+    }
+    // Between intersections of the reduced graph, the tree of the reduced graph has the answer.
+    if (chains->reduced[u] != -1 && chains->reduced[end] != -1) {
+        return nextHop(&chains->tree, chains->reduced[u], chains->reduced[end]);
+    }
+    return planChainRoute(chains, u, end).step;
+}
 
-    while (v != actor->end_id) {
-        path.push_back(world->int_to_string.at(v));
-        replacement.push(v);
-        actor->path.pop();
-        u = v;
-        v = actor->path.front();
+/*
+ * Path from start to end in a tree with contracted chains. The route is chosen once at the start, so the walk can't
+ * alternate between routes of the same length.
+ */
+static Path retrieveContractedPath(const chains_t* chains, const int start, const int end)
+{
+    Path p;
+    if (start == end) {
+        return p;
     }
-    path.push_back(world->int_to_string.at(v));
-    replacement.push(v);
-    actor->path = replacement;
-    return path;
+
+    // Between intersections of the reduced graph the route is given by the tree, otherwise it has to be planned.
+    chainRoute_t route = {0.0, -1, start, end, end, false};
+    if (chains->reduced[start] == -1 || chains->reduced[end] == -1) {
+        route = planChainRoute(chains, start, end);
+        if (route.step == -1) {
+            return {};
+        }
+    }
+
+    int u = start;
+    auto advance = [&](const int next) {
+        assert(p.size() < chains->reduced.size() && "Overflow of the path array");
+        u = next;
+        p.push(u);
+    };
+
+    if (route.direct) {
+        const bool forward = route.step == chains->forwardNext[start];
+        while (u != end) {
+            advance(forward ? chains->forwardNext[u] : chains->backwardNext[u]);
+        }
+        return p;
+    }
+
+    // Leave the chain of the start.
+    if (chains->chain[start] != -1) {
+        const bool forward = route.step == chains->forwardNext[start];
+        while (u != route.exit) {
+            advance(forward ? chains->forwardNext[u] : chains->backwardNext[u]);
+        }
+    }
+
+    // Follow the tree of the reduced graph, every chain on the way is walked to its other end.
+    while (u != route.entry) {
+        const int next = nextHop(&chains->tree, chains->reduced[u], chains->reduced[route.entry]);
+        if (next == -1) {
+            return {};
+        }
+        const int from = u;
+        advance(next);
+        if (chains->chain[u] != -1) {
+            const int c = chains->chain[u];
+            const bool forward = from == chains->start[c] && u == chains->first[c];
+            while (chains->chain[u] != -1) {
+                advance(forward ? chains->forwardNext[u] : chains->backwardNext[u]);
+            }
+        }
+    }
+
+    // Enter the chain of the end.
+    if (u != end) {
+        const int c = chains->chain[end];
+        const bool forward = route.entryStep == chains->first[c];
+        advance(route.entryStep);
+        while (u != end) {
+            advance(forward ? chains->forwardNext[u] : chains->backwardNext[u]);
+        }
+    }
+    return p;
 }
 
-std::vector<std::string> StreetPath(actor_t* actor, const world_t* world)
+Path retrievePath(spt_t* spt, const int &start, const int &end)
 {
+    if (start < 0 || end < 0) {
+        return {};
+    }
+    if (spt->chains != nullptr) {
+        return retrieveContractedPath(spt->chains, start, end);
+    }
+    if (nextHop(spt, start, end) == -1) {
+        return {};
+    }
+
     Path p;
 
-    // Initialize the path
-    int u = actor->start_id;
-    int v = actor->path.front();
-    std::vector<std::string> strPath = {};
-    Street* street = nullptr;
+    int u = start;
+//    p.push(u);
+    while (u != end) {
+        assert(u < spt->size && "Overflow of the spt array");
+        assert(p.size() < spt->size && "Overflow of the path array" && "Overflow of the spt array");
+        if (u == -1) {
+            return {};
+        }
+        u = nextHop(spt, u, end);
+        p.push(u);
+    }
+    return p;
+}
+
+std::vector<Path> retrievePaths(spt_t* spt, const std::vector<std::pair<int, int>>& queries)
+{
+    const int n = static_cast<int>(queries.size());
+    std::vector<int> order(n);
+    for (int q = 0; q < n; q++) {
+        order[q] = q;
+    }
+    std::stable_sort(order.begin(), order.end(), [&queries](const int a, const int b) {
+        return queries[a].second < queries[b].second;
+    });
+
+    std::vector<Path> paths(n);
+    #pragma omp parallel for schedule(dynamic, 256) default(none) shared(spt, queries, order, paths, n)
+    for (int i = 0; i < n; i++) {
+        const auto& [start, end] = queries[order[i]];
+        paths[order[i]] = retrievePath(spt, start, end);
+    }
+    return paths;
+}
+
+void setTreePath(actorPath_t* path, const spt_t* spt, const int start, const int end)
+{
+    path->queued.reset();
+    path->tree = spt;
+    path->end = end;
+    path->next = (start < 0 || end < 0 || start == end) ? -1 : nextHop(spt, start, end);
+}
+
+void setQueuedPath(actorPath_t* path, Path&& queued)
+{
+    path->tree = nullptr;
+    path->next = -1;
+    path->end = -1;
+    path->queued = std::make_unique<Path>(std::move(queued));
+}
 
-    // Walk along the Path
-    while (v != actor->end_id) {
-        p.push(v);
-        actor->path.pop();
+std::vector<int> pathIntersections(const actorPath_t* path)
+{
+    std::vector<int> intersections;
+    if (path->queued) {
+        Path copy = *path->queued;
+        intersections.reserve(copy.size());
+        while (!copy.empty()) {
+            intersections.push_back(copy.front());
+            copy.pop();
+        }
+        return intersections;
+    }
+    for (int v = path->next; v != -1; v = (v == path->end) ? -1 : nextHop(path->tree, v, path->end)) {
+        assert(intersections.size() < static_cast<std::size_t>(path->tree->size) && "The path has a cycle");
+        intersections.push_back(v);
+    }
+    return intersections;
+}
 
+/*
+ * Returns the streets along the remaining path of the actor, starting at start_id.
+ */
+static std::vector<const Street*> streetsOfPath(const world_t* world, const actor_t* actor)
+{
+    std::vector<const Street*> streets;
+    int u = actor->start_id;
+    for (const int v : pathIntersections(&actor->path)) {
         if (actor->type == ActorTypes::Bike) {
-            street = world->intersections.at(u).outboundBike.at(v);
+            streets.push_back(world->intersections.at(u).outboundBike.at(v));
         }
         else {
-            street = world->intersections.at(u).outboundCar.at(v);
+            streets.push_back(world->intersections.at(u).outboundCar.at(v));
         }
-        strPath.push_back(street->id);
         u = v;
-        v = actor->path.front();
     }
+    return streets;
+}
 
-    // Do the last iteration
-    p.push(v);
-    actor->path.pop();
-
-    if (actor->type == ActorTypes::Bike) {
-        street = world->intersections.at(u).outboundBike.at(v);
-    }
-    else {
-        street = world->intersections.at(u).outboundCar.at(v);
+float distanceFromPath(const world_t* world, const actor_t* actor)
+{
+    float distance = 0.0f;
+    for (const Street* street : streetsOfPath(world, actor)) {
+        distance += street->length;
     }
-    strPath.push_back(street->id);
+    return distance;
+}
 
-    // Move the new path to the actor and hope the old path get's deleted
-    actor->path = p;
+std::vector<std::string> getPath(const actor_t* actor, const world_t* world)
+{
+    std::vector<std::string> path;
+    path.push_back(world->int_to_string.at(actor->start_id));
+    for (const int v : pathIntersections(&actor->path)) {
+        path.push_back(world->int_to_string.at(v));
+    }
+    return path;
+}
 
+std::vector<std::string> StreetPath(const actor_t* actor, const world_t* world)
+{
+    std::vector<std::string> strPath = {};
+    for (const Street* street : streetsOfPath(world, actor)) {
+        strPath.push_back(street->id);
+    }
     return strPath;
 }
\ No newline at end of file
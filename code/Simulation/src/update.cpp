@@ -2,72 +2,94 @@
 #include <cmath>
 #include <cassert>
 #include <iostream>
+#include <limits>
 #include <stdexcept>
 
 #include "update.hpp"
+#include "routing.hpp"
 #include <omp.h>
 
-FrontVehicles GetFrontVehicles(const Street* street, const Actor* actor, const TrafficIterator& trafficStart, TrafficIterator& trafficEnd)
+/* Lane of the street with the given index, nullptr if no actor drives on it. */
+static const Lane* laneAt(const Street* street, const int lane)
 {
-    FrontVehicles f;
-
-    // Go through array and always update the frontVehicles if a new matching vehicle is found.
-    for (TrafficIterator iter = trafficStart; iter != trafficEnd; iter++) {
-        Actor *other = *iter; // Get pointer to actor of iterator (with *)
+    if (lane < 0 || lane >= static_cast<int>(street->lanes.size())) {
+        return nullptr;
+    }
+    return &street->lanes[lane];
+}
 
-        if (actor == other) {
-            trafficEnd = iter;
-            return f;
-        }
+/* Lane the actor drives on, the lanes are added when an actor is the first one on it. */
+static Lane* laneOf(Street* street, const Actor* actor)
+{
+    const std::size_t lane = actor->distanceToRight / LANE_WIDTH;
+    if (lane >= street->lanes.size()) {
+        street->lanes.resize(lane + 1);
+    }
+    return &street->lanes[lane];
+}
 
-        assert(other->distanceToRight <= street->width && "Vehicle is not on the street!");
+FrontVehicles GetFrontVehicles(const Street* street, const Actor* actor)
+{
+    FrontVehicles f;
+    const int lane = actor->distanceToRight / LANE_WIDTH;
 
-        // We can iterate through like that since the traffic is sorted by distanceToIntersection.
-        if (actor->distanceToRight == other->distanceToRight) {
-            f.frontVehicle = other;
-        }
-        else if (actor->distanceToRight == other->distanceToRight + LANE_WIDTH) {
-            f.frontVehicleRight = other;
-        }
-        else if (actor->distanceToRight == other->distanceToRight - LANE_WIDTH) {
-            f.frontVehicleLeft = other;
-        }
+    // The leaders are the last vehicles of their lanes before the actor in the traffic.
+    if (const Lane* own = laneAt(street, lane)) {
+        f.frontVehicle = own->leader;
+    }
+    if (const Lane* right = laneAt(street, lane - 1)) {
+        f.frontVehicleRight = right->leader;
+    }
+    if (const Lane* left = laneAt(street, lane + 1)) {
+        f.frontVehicleLeft = left->leader;
     }
-    // Don't update traffic end iterator since we want to iterate through all vehicles.
     return f;
 }
 
-FrontVehicles GetCollisionVehicles(const Street* street, const Actor* actor, const TrafficIterator start)
+FrontVehicles GetCollisionVehicles(const Street* street, const Actor* actor)
 {
     FrontVehicles f;
+    const int lane = actor->distanceToRight / LANE_WIDTH;
 
-    // Go through array and always update the frontVehicles if a new matching vehicle is found.
-    for (TrafficIterator iter = start; iter != street->traffic.end(); iter++) {
-        Actor *other = *iter; // Get pointer to actor of iterator (with *)
-        //Ignoring the actor itself
-        if (other == actor) {
-            continue;
+    // The first vehicle of a lane behind the actor, if it is close enough to collide.
+    auto follower = [street, actor](const int index) -> Actor* {
+        const Lane* other = laneAt(street, index);
+        if (other == nullptr || other->queue.empty()) {
+            return nullptr;
         }
-
-        // Return if the other vehicle is behind the actor and cannot collide
-        if (other->distanceToIntersection > actor->distanceToIntersection + actor->length + MIN_DISTANCE_BETWEEN_VEHICLES) {
-            return f;
+        Actor* vehicle = other->queue.front();
+        assert(vehicle->distanceToRight <= street->width && "Vehicle is not on the street!");
+        // The vehicle is behind the actor and cannot collide
+        if (vehicle->distanceToIntersection > actor->distanceToIntersection + actor->length + MIN_DISTANCE_BETWEEN_VEHICLES) {
+            return nullptr;
         }
+        return vehicle;
+    };
 
-        assert(other->distanceToRight <= street->width && "Vehicle is not on the street!");
+    f.frontVehicle = follower(lane);
+    f.frontVehicleRight = follower(lane - 1);
+    f.frontVehicleLeft = follower(lane + 1);
+    return f;
+}
 
-        // We can iterate through like that since the traffic is sorted by distanceToIntersection.
-        if (actor->distanceToRight == other->distanceToRight) {
-            f.frontVehicle = other;
-        }
-        else if (actor->distanceToRight == other->distanceToRight + LANE_WIDTH) {
-            f.frontVehicleRight = other;
-        }
-        else if (actor->distanceToRight == other->distanceToRight - LANE_WIDTH) {
-            f.frontVehicleLeft = other;
-        }
+void prepareLanes(Street* street)
+{
+    for (Lane& lane : street->lanes) {
+        lane.queue.clear();
+        lane.leader = nullptr;
+    }
+    for (Actor* actor : street->traffic) {
+        laneOf(street, actor)->queue.push_back(actor);
+    }
+}
+
+/* Marks the actor as passed by the update of the street, it is the leader of its lane for the following actors. */
+static void passActor(Street* street, Actor* actor)
+{
+    Lane* lane = laneOf(street, actor);
+    if (lane->leader == nullptr || trafficOrder(lane->leader, actor)) {
+        lane->leader = actor;
     }
-    return f;
 }
 
 Actor* moveToOptimalLane(Street* street, Actor* actor)
@@ -75,10 +97,8 @@ Actor* moveToOptimalLane(Street* street, Actor* actor)
     assert((street->type != StreetTypes::OnlyCar || actor->type != ActorTypes::Bike) && "Bike is not allowed on this street!");
     assert((street->type != StreetTypes::OnlyBike || actor->type != ActorTypes::Car) && "Car is not allowed on this street!");
 
-    TrafficIterator start = street->traffic.begin();
-    TrafficIterator end = street->traffic.end();
     // Get front vehicles
-    FrontVehicles frontActors = GetFrontVehicles(street, actor, start, end);
+    FrontVehicles frontActors = GetFrontVehicles(street, actor);
 
     // Don't update the shit if we are a bike in a normal street.
     if (actor->type == ActorTypes::Bike && street->type == StreetTypes::Both) {
@@ -86,7 +106,7 @@ Actor* moveToOptimalLane(Street* street, Actor* actor)
     }
 
     // Locate vehicles which could possibly collide
-    FrontVehicles collisionVehicle = GetCollisionVehicles(street, actor, end);
+    FrontVehicles collisionVehicle = GetCollisionVehicles(street, actor);
 
     // Check in front
     float frontDistance = actor->distanceToIntersection;
@@ -173,8 +193,8 @@ void updateCount(Street* street, Actor* actor)
 // Updated Version of Alex to handle zero velocity vehicles.
 bool tryInsertInNextStreet(Intersection* intersection, Actor* actor, World* world)
 {
-    assert(!actor->path.empty() && "tryInsertInNextStreet may not be called with an Actor that has an empty path!");
-    Street* target = (actor->type == ActorTypes::Bike) ? intersection->outboundBike.at(actor->path.front()) : intersection->outboundCar.at(actor->path.front());
+    assert(!pathEmpty(&actor->path) && "tryInsertInNextStreet may not be called with an Actor that has an empty path!");
+    Street* target = (actor->type == ActorTypes::Bike) ? intersection->outboundBike.at(pathFront(&actor->path)) : intersection->outboundCar.at(pathFront(&actor->path));
 
     // Empty, insert immediately and return
     if (target->traffic.empty()) {
@@ -283,201 +303,557 @@ void updateIntersectionPhase(Intersection* intersection, float timeDelta, bool s
     }
 }
 
-void singleIntersectionStrideUpdate(world_t* world, const float timeDelta, bool stupidIntersections, const float current_time, const int stride, const int offset)
+/* Update of a single intersection, see singleIntersectionStrideUpdate. */
+static void updateSingleIntersection(world_t* world, Intersection* intersection, const float timeDelta, bool stupidIntersections, const float current_time)
 {
-    // Move so no thread is colliding with another thread.
-    for (int32_t x = offset; x < world->intersections.size(); x += stride) {
-        Intersection* intersection = world->IntersectionPtr.at(x);
-
-        if (intersection->hasTrafficLight) {
-            updateIntersectionPhase(intersection, timeDelta, stupidIntersections);
-
-            Street* street = intersection->inbound.at(intersection->green);
-            for (TrafficIterator iter = street->traffic.begin(); iter != street->traffic.end(); iter++) {
-                Actor* actor = *iter;
-
-                if (actor->distanceToIntersection >= DISTANCE_TO_CROSSING_FOR_TELEPORT)
-                    // No vehicle is close enough to change street
-                    break;
-
-                // Everything that can be done in parallel, executed in parallel
-                if (actor->path.empty()) {
-                    // Actor has arrived at its target
-                    actor->outputFlag = false; // make sure new active status is outputted once
-                    actor->end_time = current_time;
-                    actor->arrived = true;
-                    intersection->needsUpdate = true;
-                    break;
-                }
+    if (intersection->hasTrafficLight) {
+        updateIntersectionPhase(intersection, timeDelta, stupidIntersections);
+
+        Street* street = intersection->inbound.at(intersection->green);
+        for (TrafficIterator iter = street->traffic.begin(); iter != street->traffic.end(); iter++) {
+            Actor* actor = *iter;
+
+            if (actor->distanceToIntersection >= DISTANCE_TO_CROSSING_FOR_TELEPORT)
+                // No vehicle is close enough to change street
+                break;
+
+            // Everything that can be done in parallel, executed in parallel
+            if (pathEmpty(&actor->path)) {
+                // Actor has arrived at its target
+                actor->outputFlag = false; // make sure new active status is outputted once
+                actor->end_time = current_time;
+                actor->arrived = true;
+                intersection->needsUpdate = true;
+                break;
+            }
 
-                if (tryInsertInNextStreet(intersection, actor, world)) {
-                    actor->Teleport = true;
-                    intersection->needsUpdate = true;
-                    intersection->car_flow_accumulate += 1.0f * static_cast<float>(actor->type == ActorTypes::Car);
-                    intersection->bike_flow_accumulate += 1.0f * static_cast<float>(actor->type == ActorTypes::Bike);
-                    break; // I don't know if removing an element from a vector during iteration would lead to good code, hence break
-                }
+            if (tryInsertInNextStreet(intersection, actor, world)) {
+                actor->Teleport = true;
+                intersection->needsUpdate = true;
+                intersection->car_flow_accumulate += 1.0f * static_cast<float>(actor->type == ActorTypes::Car);
+                intersection->bike_flow_accumulate += 1.0f * static_cast<float>(actor->type == ActorTypes::Bike);
+                break; // I don't know if removing an element from a vector during iteration would lead to good code, hence break
             }
         }
-        else {
-            for (int i = 0; i < intersection->inbound.size(); i++) {
-                int index = (i + intersection->green) % static_cast<int>(intersection->inbound.size());
-                Street* street = intersection->inbound.at(index);
+    }
+    else {
+        for (int i = 0; i < intersection->inbound.size(); i++) {
+            int index = (i + intersection->green) % static_cast<int>(intersection->inbound.size());
+            Street* street = intersection->inbound.at(index);
 
-                // Ignore empty streets
-                if (street->traffic.size() == 0) {
-                    continue;
-                }
+            // Ignore empty streets
+            if (street->traffic.size() == 0) {
+                continue;
+            }
 
-                Actor* actor = street->traffic.front();
+            Actor* actor = street->traffic.front();
 
-                // Check if front actor is eligible to change street
-                if (actor->distanceToIntersection >= DISTANCE_TO_CROSSING_FOR_TELEPORT) {
-                    continue;
-                }
+            // Check if front actor is eligible to change street
+            if (actor->distanceToIntersection >= DISTANCE_TO_CROSSING_FOR_TELEPORT) {
+                continue;
+            }
 
-                // Actor has arrived at its destination
-                if (actor->path.empty()) {
-                    // Actor has arrived at its target
-                    actor->outputFlag = false; // make sure new active status is outputted once
-                    actor->end_time = current_time;
-                    actor->arrived = true;
-                    intersection->needsUpdate = true;
-                    break;
-                }
+            // Actor has arrived at its destination
+            if (pathEmpty(&actor->path)) {
+                // Actor has arrived at its target
+                actor->outputFlag = false; // make sure new active status is outputted once
+                actor->end_time = current_time;
+                actor->arrived = true;
+                intersection->needsUpdate = true;
+                break;
+            }
 
-                if (tryInsertInNextStreet(intersection, actor, world)) {
-                    actor->Teleport = true;
-                    intersection->needsUpdate = true;
-                    intersection->car_flow_accumulate += 1.0f * static_cast<float>(actor->type == ActorTypes::Car);
-                    intersection->bike_flow_accumulate += 1.0f * static_cast<float>(actor->type == ActorTypes::Bike);
-                    intersection->green = index;
-                    break; // I don't know if removing an element from a vector during iteration would lead to good code, hence break
-                }
+            if (tryInsertInNextStreet(intersection, actor, world)) {
+                actor->Teleport = true;
+                intersection->needsUpdate = true;
+                intersection->car_flow_accumulate += 1.0f * static_cast<float>(actor->type == ActorTypes::Car);
+                intersection->bike_flow_accumulate += 1.0f * static_cast<float>(actor->type == ActorTypes::Bike);
+                intersection->green = index;
+                break; // I don't know if removing an element from a vector during iteration would lead to good code, hence break
             }
         }
     }
 }
 
+void singleIntersectionStrideUpdate(world_t* world, const float timeDelta, bool stupidIntersections, const float current_time, const int stride, const int offset)
+{
+    // Move so no thread is colliding with another thread.
+    for (int32_t x = offset; x < world->intersections.size(); x += stride) {
+        updateSingleIntersection(world, world->IntersectionPtr.at(x), timeDelta, stupidIntersections, current_time);
+    }
+}
+
+/* Insertion of the next waiting actor of a single intersection, see singleIntersectionStrideUpdateInsert. */
+static void insertSingleIntersection(world_t* world, Intersection* intersection, const float current_time)
+{
+    // Adding new traffic to street needs to happen last, to reduce the likelihood of deadlocks with too many cars.
+    if (intersection->waitingToBeInserted.size() > 0) {
+        Actor* actor = intersection->waitingToBeInserted[0];
+        // Ignoring the actor if it is not it's start time yet.
+        if (actor->insertAfter <= current_time && tryInsertInNextStreet(intersection, actor, world)) {
+            actor->start_time = current_time * static_cast<float>(actor->start_time == -1.0f)
+                                + actor->start_time * static_cast<float>(actor->start_time != -1.0f); // only set the start time if the if the start time
+            actor->Teleport = true;
+            intersection->needsUpdate = true;
+        }
+    }
+}
+
 void singleIntersectionStrideUpdateInsert(world_t* world, const float current_time, const int stride, const int offset)
 {
     // Move so no thread is colliding with another thread.
     for (int32_t x = offset; x < world->intersections.size(); x += stride) {
-        Intersection* intersection = world->IntersectionPtr.at(x);
-
-        // Adding new traffic to street needs to happen last, to reduce the likelihood of deadlocks with too many cars.
-        if (intersection->waitingToBeInserted.size() > 0) {
-            Actor* actor = intersection->waitingToBeInserted[0];
-            // Ignoring the actor if it is not it's start time yet.
-            if (actor->insertAfter <= current_time && tryInsertInNextStreet(intersection, actor, world)) {
-                actor->start_time = current_time * static_cast<float>(actor->start_time == -1.0f)
-                                    + actor->start_time * static_cast<float>(actor->start_time != -1.0f); // only set the start time if the if the start time
-                actor->Teleport = true;
-                intersection->needsUpdate = true;
-            }
+        insertSingleIntersection(world, world->IntersectionPtr.at(x), current_time);
+    }
+}
+
+/* Inserts the waiting actor flagged by insertSingleIntersection. Only touches the intersection and its outbound streets. */
+static void commitSingleInsert(Intersection* intersection)
+{
+    // Skipping intersection that don't need to be updated
+    if (!intersection->needsUpdate) {
+        return;
+    }
+
+    // Resetting the needsUpdate flag
+    intersection->needsUpdate = false;
+
+    // Adding new traffic to street needs to happen last, to reduce the likelihood of deadlocks with too many cars.
+    if (intersection->waitingToBeInserted.size() > 0) {
+        Actor* actor = intersection->waitingToBeInserted[0];
+        // Ignoring the actor if it is not it's start time yet.
+        if (actor->Teleport) {
+
+            actor->Teleport = false;
+            actor->distanceToRight = actor->tempDistanceToRight;
+            intersection->waitingToBeInserted.pop_front();
+            Street* target = (actor->type == ActorTypes::Bike) ? intersection->outboundBike.at(pathFront(&actor->path)) : intersection->outboundCar.at(pathFront(&actor->path));
+            target->traffic.push_back(actor);
+            intersection->entered.push_back(target);
+            intersection->departed++;
+            pathPop(&actor->path);
         }
     }
 }
 
 void updatetInsertData(world_t* world)
 {
-    for (int32_t x = 0; x < world->intersections.size(); ++x) {
-        Intersection* intersection = world->IntersectionPtr.at(x);
+    const int intersections = static_cast<int>(world->activeIntersections.size());
 
-        // Skipping intersection that don't need to be updated
-        if (!intersection->needsUpdate) {
-            continue;
-        }
+    // Only the start intersection of a street appends to it here and nothing is removed, so intersections do not conflict
+    #pragma omp parallel for schedule(dynamic, INTERSECTION_CHUNK) default(none) shared(world, intersections)
+    for (int x = 0; x < intersections; x++) {
+        commitSingleInsert(world->activeIntersections[x]);
+    }
+}
+
+/* Moves the actor flagged by updateSingleIntersection. Removes from the inbound streets, hands over to the outbound streets. */
+static void commitSingleIntersection(Intersection* intersection)
+{
+    // Skipping intersection that don't need to be updated
+    if (!intersection->needsUpdate) {
+        return;
+    }
 
-        // Resetting the needsUpdate flag
-        intersection->needsUpdate = false;
+    // Resetting the needsUpdate flag
+    intersection->needsUpdate = false;
+
+    if (intersection->hasTrafficLight) {
+
+        Street* street = intersection->inbound.at(intersection->green);
+        for (TrafficIterator iter = street->traffic.begin(); iter != street->traffic.end(); iter++) {
+            Actor* actor = *iter;
+            // Everything that can be done in parallel, executed in parallel
+            if (actor->arrived) {
+                // Actor has arrived at its target
+                actor->arrived = false;
+                street->traffic.erase(iter);
+                intersection->arrivedFrom.push_back({actor, street});
+                intersection->arrived++;
+                break;
+            }
 
-        // Adding new traffic to street needs to happen last, to reduce the likelihood of deadlocks with too many cars.
-        if (intersection->waitingToBeInserted.size() > 0) {
-            Actor* actor = intersection->waitingToBeInserted[0];
-            // Ignoring the actor if it is not it's start time yet.
             if (actor->Teleport) {
+                actor->Teleport = false;
+                actor->distanceToRight = actor->tempDistanceToRight;
+                street->traffic.erase(iter);
+                Street* target = (actor->type == ActorTypes::Bike) ? intersection->outboundBike.at(pathFront(&actor->path)) : intersection->outboundCar.at(pathFront(&actor->path));
+                target->incoming.push_back(actor);
+                intersection->entered.push_back(target);
+                pathPop(&actor->path);
+                break; // I don't know if removing an element from a vector during iteration would lead to good code, hence break
+            }
+        }
+    }
+    else {
+        for (int i = 0; i < intersection->inbound.size(); i++) {
+            Street* street = intersection->inbound.at(i);
+
+            // Ignore empty streets
+            if (street->traffic.size() == 0) {
+                continue;
+            }
+
+            Actor* actor = street->traffic.front();
+
+            // Actor has arrived at its destination
+            if (actor->arrived) {
+                // Actor has arrived at its target
+                actor->arrived = false; // make sure new active status is outputted once
+                street->traffic.erase(street->traffic.begin());
+                intersection->arrivedFrom.push_back({actor, street});
+                intersection->arrived++;
+                break;
+            }
 
+            if (actor->Teleport) {
                 actor->Teleport = false;
                 actor->distanceToRight = actor->tempDistanceToRight;
-                intersection->waitingToBeInserted.erase(intersection->waitingToBeInserted.begin());
-                Street* target = (actor->type == ActorTypes::Bike) ? intersection->outboundBike.at(actor->path.front()) : intersection->outboundCar.at(actor->path.front());
-                target->traffic.push_back(actor);
-                actor->path.pop();
+                street->traffic.erase(street->traffic.begin());
+                Street* target = (actor->type == ActorTypes::Bike) ? intersection->outboundBike.at(pathFront(&actor->path)) : intersection->outboundCar.at(pathFront(&actor->path));
+                target->incoming.push_back(actor);
+                intersection->entered.push_back(target);
+                pathPop(&actor->path);
+                break; // I don't know if removing an element from a vector during iteration would lead to good code, hence break
             }
         }
     }
 }
+
+/* Appends the actors the intersection handed over to its outbound streets to their traffic. */
+static void drainIncoming(Intersection* intersection)
+{
+    for (Street* street : intersection->entered) {
+        street->traffic.insert(street->traffic.end(), street->incoming.begin(), street->incoming.end());
+        street->incoming.clear();
+    }
+}
+
 void updateData(world_t* world)
 {
-    for (int32_t x = 0; x < world->intersections.size(); ++x) {
-        Intersection* intersection = world->IntersectionPtr.at(x);
+    const int intersections = static_cast<int>(world->activeIntersections.size());
+
+    // A street is only erased from by its end intersection and only handed actors by its start intersection
+    #pragma omp parallel for schedule(dynamic, INTERSECTION_CHUNK) default(none) shared(world, intersections)
+    for (int x = 0; x < intersections; x++) {
+        commitSingleIntersection(world->activeIntersections[x]);
+    }
+
+    // Erasing and appending commute, so the traffic is the same as when committing the intersections one by one
+    #pragma omp parallel for schedule(dynamic, INTERSECTION_CHUNK) default(none) shared(world, intersections)
+    for (int x = 0; x < intersections; x++) {
+        drainIncoming(world->activeIntersections[x]);
+    }
+}
+
+/* Lists the intersection in World::activeIntersections, unless it already is. */
+static void activateIntersection(world_t* world, Intersection* intersection)
+{
+    if (!intersection->active) {
+        intersection->active = true;
+        world->activeIntersections.push_back(intersection);
+    }
+}
+
+/*
+ * Restores the order of World::intersections in the active intersections after the ones from kept on were added.
+ * Intersections read the actors at the end of their outbound streets while the end intersections of these streets
+ * teleport them, so the order decides the result when they are the same actor.
+ */
+static void sortActivated(world_t* world, const std::size_t kept)
+{
+    std::vector<Intersection*>& active = world->activeIntersections;
+    std::sort(active.begin() + static_cast<std::ptrdiff_t>(kept), active.end());
+    std::inplace_merge(active.begin(), active.begin() + static_cast<std::ptrdiff_t>(kept), active.end());
+}
+
+/* Adds the end intersections of the active streets to the active intersections. */
+static void activateEndIntersections(world_t* world)
+{
+    const std::size_t kept = world->activeIntersections.size();
+    for (Street* street : world->activeStreets) {
+        activateIntersection(world, &world->intersections[street->end]);
+    }
+    sortActivated(world, kept);
+}
+
+/* Puts the departure of the first waiting actor of the intersection into World::departures, if it isn't already. */
+static void scheduleDeparture(world_t* world, Intersection* intersection)
+{
+    const float departure = intersection->waitingToBeInserted.front()->insertAfter;
+    if (intersection->departure != departure) {
+        intersection->departure = departure;
+        world->departures.emplace(departure, static_cast<int>(intersection - world->intersections.data()));
+    }
+}
 
-        // Skipping intersection that don't need to be updated
-        if (!intersection->needsUpdate) {
+void releaseDepartures(world_t* world, const float current_time)
+{
+    const std::size_t kept = world->activeIntersections.size();
+    while (!world->departures.empty() && world->departures.top().first <= current_time) {
+        const auto [departure, index] = world->departures.top();
+        world->departures.pop();
+        Intersection* intersection = &world->intersections[index];
+
+        // The first waiting actor changed after the departure was scheduled, its own departure is scheduled as well.
+        if (intersection->departure != departure) {
             continue;
         }
+        intersection->departure = std::numeric_limits<float>::infinity();
+        intersection->ready = true;
+        activateIntersection(world, intersection);
+    }
+    sortActivated(world, kept);
+}
+
+void buildActiveSets(world_t* world)
+{
+    world->activeStreets.clear();
+    world->activeIntersections.clear();
+    world->departures = {};
+    world->waitingActors = 0;
+    world->drivingActors = 0;
+    world->arrivedActors = 0;
+    for (const Actor* actor : world->actors) {
+        world->arrivedActors += actor != nullptr && actor->end_time != -1.0f;
+    }
+    for (Street& street : world->streets) {
+        world->drivingActors += street.traffic.size();
+        street.active = !street.traffic.empty();
+        if (street.active) {
+            world->activeStreets.push_back(&street);
+        }
+    }
+    for (Intersection& intersection : world->intersections) {
+        world->waitingActors += intersection.waitingToBeInserted.size();
+        intersection.entered.clear();
+        intersection.departed = 0;
+        intersection.arrived = 0;
+        intersection.ready = false;
+        intersection.departure = std::numeric_limits<float>::infinity();
+        if (!intersection.waitingToBeInserted.empty()) {
+            scheduleDeparture(world, &intersection);
+        }
+        intersection.active = intersection.hasTrafficLight;
+        if (intersection.active) {
+            world->activeIntersections.push_back(&intersection);
+        }
+    }
+    activateEndIntersections(world);
+    world->activeSetsValid = true;
+}
 
-        // Resetting the needsUpdate flag
-        intersection->needsUpdate = false;
+void refreshActiveSets(world_t* world, const float current_time)
+{
+    // Streets which lost their last actor drop out, the ones actors entered join.
+    std::size_t kept = 0;
+    for (Street* street : world->activeStreets) {
+        street->active = !street->traffic.empty();
+        if (street->active) {
+            world->activeStreets[kept++] = street;
+        }
+    }
+    world->activeStreets.resize(kept);
+    for (Intersection* intersection : world->activeIntersections) {
+        for (Street* street : intersection->entered) {
+            if (!street->active && !street->traffic.empty()) {
+                street->active = true;
+                world->activeStreets.push_back(street);
+            }
+        }
+        intersection->entered.clear();
+
+        world->waitingActors -= intersection->departed;
+        world->drivingActors += intersection->departed;
+        world->drivingActors -= intersection->arrived;
+        world->arrivedActors += intersection->arrived;
+        intersection->departed = 0;
+        intersection->arrived = 0;
+    }
 
-        if (intersection->hasTrafficLight) {
+    // An intersection stays ready while its first waiting actor may depart, otherwise it waits for the next departure.
+    // Only intersections with a running signal phase, a departure or traffic on an inbound street can do anything.
+    kept = 0;
+    for (Intersection* intersection : world->activeIntersections) {
+        const std::deque<Actor*>& waiting = intersection->waitingToBeInserted;
+        intersection->ready = !waiting.empty() && waiting.front()->insertAfter <= current_time;
+        if (!waiting.empty() && !intersection->ready) {
+            scheduleDeparture(world, intersection);
+        }
+        intersection->active = intersection->hasTrafficLight || intersection->ready;
+        if (intersection->active) {
+            world->activeIntersections[kept++] = intersection;
+        }
+    }
+    world->activeIntersections.resize(kept);
+    activateEndIntersections(world);
+}
 
-            Street* street = intersection->inbound.at(intersection->green);
-            for (TrafficIterator iter = street->traffic.begin(); iter != street->traffic.end(); iter++) {
-                Actor* actor = *iter;
-                // Everything that can be done in parallel, executed in parallel
-                if (actor->arrived) {
-                    // Actor has arrived at its target
-                    actor->arrived = false;
-                    street->traffic.erase(iter);
-                    intersection->arrivedFrom.push_back({actor, street});
-                    break;
-                }
+bool trafficOrder(const Actor* a, const Actor* b)
+{
+    // Lexicographical order, starting with distanceToIntersection and then distanceToRight
+    if (a->distanceToIntersection == b->distanceToIntersection) {
+        // this if statement make sure that no vehicles have the same ordering
+        if (a->distanceToRight == b->distanceToRight) {
+            return a < b;
+        }
+        return a->distanceToRight < b->distanceToRight;
+    }
+    return a->distanceToIntersection < b->distanceToIntersection;
+}
 
-                if (actor->Teleport) {
-                    actor->Teleport = false;
-                    actor->distanceToRight = actor->tempDistanceToRight;
-                    street->traffic.erase(iter);
-                    Street* target = (actor->type == ActorTypes::Bike) ? intersection->outboundBike.at(actor->path.front()) : intersection->outboundCar.at(actor->path.front());
-                    target->traffic.push_back(actor);
-                    actor->path.pop();
-                    break; // I don't know if removing an element from a vector during iteration would lead to good code, hence break
-                }
-            }
+std::size_t restoreTrafficOrder(std::vector<Actor*>& traffic, std::size_t index)
+{
+    while (index > 0 && trafficOrder(traffic[index], traffic[index - 1])) {
+        std::swap(traffic[index], traffic[index - 1]);
+        index--;
+    }
+    while (index + 1 < traffic.size() && trafficOrder(traffic[index + 1], traffic[index])) {
+        std::swap(traffic[index], traffic[index + 1]);
+        index++;
+    }
+    return index;
+}
+
+/* x^N with the multiplications of repeated squaring, the compiler unrolls it completely. */
+template<int N>
+static inline float integerPower(const float x)
+{
+    if constexpr (N == 1) {
+        return x;
+    }
+    else if constexpr (N % 2 == 0) {
+        const float half = integerPower<N / 2>(x);
+        return half * half;
+    }
+    else {
+        return x * integerPower<N - 1>(x);
+    }
+}
+
+/* Picks the kernel for the integer exponent of the actor, std::pow if it has none. */
+template<int N>
+static inline float freeRoadTerm(const Actor* actor, const float ratio)
+{
+    if constexpr (N == 0) {
+        return std::pow(ratio, actor->acceleration_exp);
+    }
+    else {
+        if (actor->integer_exp == N) {
+            return integerPower<N>(ratio);
+        }
+        return freeRoadTerm<N - 1>(actor, ratio);
+    }
+}
+
+float idmAcceleration(const Actor* actor, const Actor* frontVehicle, const float maxDrivableDistance)
+{
+    const float freeRoad = freeRoadTerm<MAX_INTEGER_EXPONENT>(actor, actor->current_velocity / actor->target_velocity);
+    const float braking = (frontVehicle == nullptr) ?
+                          dynamicBrakingDistance(actor, -1 * actor->current_velocity, false) :
+                          dynamicBrakingDistance(actor, actor->current_velocity - frontVehicle->current_velocity, true);
+    return actor->acceleration * (1 - freeRoad - std::pow(braking / maxDrivableDistance, 2.0f));
+}
+
+/* Update of a single street, see singleStreetStrideUpdate. */
+static bool updateSingleStreet(Street* street, const float timeDelta)
+{
+    bool actorMoved = false;
+    int bikes = 0;
+    int cars = 0;
+
+    // Actors which entered the street since the last step are appended, everything else is still in order.
+    if (!std::is_sorted(street->traffic.begin(), street->traffic.end(), trafficOrder)) {
+        std::sort(street->traffic.begin(), street->traffic.end(), trafficOrder);
+    }
+    prepareLanes(street);
+
+    for (int32_t i = 0; i < street->traffic.size(); i++) {
+        Actor* actor = street->traffic[i];
+        Lane* lane = laneOf(street, actor);
+        assert(lane->queue.front() == actor && "Lanes are in the order of the traffic");
+        lane->queue.pop_front();
+
+        if (actor->type == ActorTypes::Bike) {
+            bikes++;
         }
         else {
-            for (int i = 0; i < intersection->inbound.size(); i++) {
-                Street* street = intersection->inbound.at(i);
+            cars++;
+        }
 
-                // Ignore empty streets
-                if (street->traffic.size() == 0) {
-                    continue;
-                }
+        const float distance = actor->current_velocity * timeDelta;
 
-                Actor* actor = street->traffic.front();
+        // Find all traffic which could be colliding with vehicle
+        Actor* frontVehicle = moveToOptimalLane(street, actor);
 
-                // Actor has arrived at its destination
-                if (actor->arrived) {
-                    // Actor has arrived at its target
-                    actor->arrived = false; // make sure new active status is outputted once
-                    street->traffic.erase(street->traffic.begin());
-                    intersection->arrivedFrom.push_back({actor, street});
-                    break;
-                }
+        float maxDrivableDistance = actor->distanceToIntersection;
+        float movement_distance = std::min(distance, actor->distanceToIntersection); // Don't overshoot intersection
 
-                if (actor->Teleport) {
-                    actor->Teleport = false;
-                    actor->distanceToRight = actor->tempDistanceToRight;
-                    street->traffic.erase(street->traffic.begin());
-                    Street* target = (actor->type == ActorTypes::Bike) ? intersection->outboundBike.at(actor->path.front()) : intersection->outboundCar.at(actor->path.front());
-                    target->traffic.push_back(actor);
-                    actor->path.pop();
-                    break; // I don't know if removing an element from a vector during iteration would lead to good code, hence break
-                }
-            }
+        // Compute updated stuff
+        if (frontVehicle != nullptr) {
+            maxDrivableDistance = std::min(maxDrivableDistance, actor->distanceToIntersection
+                                           - (frontVehicle->length
+                                              + frontVehicle->distanceToIntersection
+                                              + MIN_DISTANCE_BETWEEN_VEHICLES));
+            movement_distance = std::min(distance, actor->distanceToIntersection
+                                         - (frontVehicle->length
+                                            + frontVehicle->distanceToIntersection
+                                            + MIN_DISTANCE_BETWEEN_VEHICLES));
+
+            assert(frontVehicle->distanceToIntersection + frontVehicle->length + MIN_DISTANCE_BETWEEN_VEHICLES <=
+                   actor->distanceToIntersection - movement_distance);
         }
+        actor->distanceToIntersection -= movement_distance;
+        actorMoved = actorMoved || movement_distance > 0.0f;
+        actor->time_spent_waiting += static_cast<float>(movement_distance == 0.0f) * timeDelta;
+        // Clamping distance
+        if (actor->distanceToIntersection < 0.01f) {
+            actor->distanceToIntersection = 0;
+        }
+
+        actor->current_velocity = std::min(std::max(actor->current_acceleration * timeDelta + actor->current_velocity, 0.0f),
+                                           actor->max_velocity);
+        if (actor->current_velocity < 0.01f) {
+            actor->current_velocity = 0;
+        }
+
+        // Only update the speed with formula if the vehicle is not at the end of the street (div by zero error)
+        // and if the distance to intersection was not updated beforehand to 0.
+        if (actor->distanceToIntersection > 0.0f && maxDrivableDistance > 0.0f) {
+
+            // Simplifying assumption. An Actor can at maximum only "see" up to the next intersection. This is
+            // advantageous both for MPI (If it was to be added) and it doesn't require the addition of a datastructure.
+            actor->current_acceleration = idmAcceleration(actor, frontVehicle, maxDrivableDistance);
+        }
+        else {
+            actor->current_acceleration = 0.0f;
+            actor->current_velocity = 0.0f;
+        }
+        // Only this actor moved, so moving it to its place sorts the traffic again.
+        const std::size_t index = restoreTrafficOrder(street->traffic, i);
+        assert(std::is_sorted(street->traffic.begin(), street->traffic.end(), trafficOrder) && "Street is sorted");
+        if (index <= static_cast<std::size_t>(i)) {
+            passActor(street, actor);
+        }
+        else {
+            // The actor fell behind the next one, which is skipped now, and is updated again when it is reached.
+            Actor* skipped = street->traffic[i];
+            assert(laneOf(street, skipped)->queue.front() == skipped && "Lanes are in the order of the traffic");
+            laneOf(street, skipped)->queue.pop_front();
+            passActor(street, skipped);
+            std::deque<Actor*>& queue = laneOf(street, actor)->queue;
+            queue.insert(std::lower_bound(queue.begin(), queue.end(), actor, trafficOrder), actor);
+        }
+
+        actor->distanceToFront = maxDrivableDistance;
     }
+
+    street->density_accumulate_bike += static_cast<float>(bikes) / street->length;
+    street->flow_accumulate_bike += static_cast<float>(bikes) / timeDelta;
+    street->density_accumulate_car += static_cast<float>(cars) / street->length;
+    street->flow_accumulate_car += static_cast<float>(cars) / timeDelta;
+
+    return actorMoved;
 }
 
 bool singleStreetStrideUpdate(world_t* world, const float timeDelta, const int stride, const int offset)
@@ -485,127 +861,123 @@ bool singleStreetStrideUpdate(world_t* world, const float timeDelta, const int s
     bool actorMoved = false;
 
     for (int32_t x = offset; x < world->streets.size(); x+=stride) {
-        Street *street = world->StreetPtr.at(x);
-        int bikes = 0;
-        int cars = 0;
+        actorMoved = updateSingleStreet(world->StreetPtr.at(x), timeDelta) || actorMoved;
+    }
 
-        for (int32_t i = 0; i < street->traffic.size(); i++) {
-            Actor* actor = street->traffic[i];
+    return actorMoved;
+}
 
-            if (actor->type == ActorTypes::Bike) {
-                bikes++;
-            }
-            else {
-                cars++;
-            }
+std::vector<WorkChunk> balancedChunks(const std::vector<std::size_t>& costs, const int chunks)
+{
+    std::size_t total = 0;
+    for (const std::size_t cost : costs) {
+        total += cost;
+    }
+    const std::size_t target = std::max<std::size_t>(1, (total + chunks - 1) / std::max(1, chunks));
+
+    std::vector<WorkChunk> result;
+    WorkChunk chunk = {0, 0, 0};
+    for (int i = 0; i < static_cast<int>(costs.size()); i++) {
+        // An item which would push the chunk past the target starts a new one, so expensive items end up on their own.
+        if (chunk.last > chunk.first && chunk.cost + costs[i] > target) {
+            result.push_back(chunk);
+            chunk = {i, i, 0};
+        }
+        chunk.cost += costs[i];
+        chunk.last = i + 1;
+        if (chunk.cost >= target) {
+            result.push_back(chunk);
+            chunk = {i + 1, i + 1, 0};
+        }
+    }
+    if (chunk.last > chunk.first) {
+        result.push_back(chunk);
+    }
 
-            const float distance = actor->current_velocity * timeDelta;
+    // Expensive chunks first, so the cheap ones fill up the threads at the end.
+    std::stable_sort(result.begin(), result.end(), [](const WorkChunk& a, const WorkChunk& b) {
+        return a.cost > b.cost;
+    });
+    return result;
+}
 
-            // Find all traffic which could be colliding with vehicle
-            Actor* frontVehicle = moveToOptimalLane(street, actor);
+/*
+ * Worksharing part of updateStreets, called by every thread of a parallel region. Every thread ors whether it moved an
+ * actor into actorMoved, which is only complete after the next barrier.
+ */
+static void streetPhase(world_t* world, const float timeDelta, std::vector<WorkChunk>& chunks, int& actorMoved)
+{
+    #pragma omp single
+    {
+        if (!world->activeSetsValid) {
+            buildActiveSets(world);
+        }
 
-            float maxDrivableDistance = actor->distanceToIntersection;
-            float movement_distance = std::min(distance, actor->distanceToIntersection); // Don't overshoot intersection
+        // Sorting and updating a street is linear in its traffic, empty streets are not active and are skipped.
+        std::vector<std::size_t> costs(world->activeStreets.size());
+        for (std::size_t i = 0; i < costs.size(); i++) {
+            costs[i] = world->activeStreets[i]->traffic.size() + 1;
+        }
+        chunks = balancedChunks(costs, omp_get_num_threads() * CHUNKS_PER_THREAD);
+    }
 
-            // Compute updated stuff
-            if (frontVehicle != nullptr) {
-                maxDrivableDistance = std::min(maxDrivableDistance, actor->distanceToIntersection
-                                               - (frontVehicle->length
-                                                  + frontVehicle->distanceToIntersection
-                                                  + MIN_DISTANCE_BETWEEN_VEHICLES));
-                movement_distance = std::min(distance, actor->distanceToIntersection
-                                             - (frontVehicle->length
-                                                + frontVehicle->distanceToIntersection
-                                                + MIN_DISTANCE_BETWEEN_VEHICLES));
+    // Threads which are done take the next chunk, so a few congested streets don't leave the other threads idle.
+    bool moved = false;
+    #pragma omp for schedule(dynamic, 1) nowait
+    for (std::size_t c = 0; c < chunks.size(); c++) {
+        for (int x = chunks[c].first; x < chunks[c].last; x++) {
+            moved = updateSingleStreet(world->activeStreets[x], timeDelta) || moved;
+        }
+    }
+    #pragma omp atomic
+    actorMoved |= static_cast<int>(moved);
+}
 
-                assert(frontVehicle->distanceToIntersection + frontVehicle->length + MIN_DISTANCE_BETWEEN_VEHICLES <=
-                       actor->distanceToIntersection - movement_distance);
-            }
-            actor->distanceToIntersection -= movement_distance;
-            actorMoved = actorMoved || movement_distance > 0.0f;
-            actor->time_spent_waiting += static_cast<float>(movement_distance == 0.0f) * timeDelta;
-            // Clamping distance
-            if (actor->distanceToIntersection < 0.01f) {
-                actor->distanceToIntersection = 0;
-            }
+/* Worksharing part of updateIntersections, called by every thread of a parallel region. */
+static void intersectionPhase(world_t* world, const float timeDelta, bool stupidIntersections, const float current_time)
+{
+    #pragma omp single
+    {
+        if (!world->activeSetsValid) {
+            buildActiveSets(world);
+        }
+        releaseDepartures(world, current_time);
+    }
+    const int intersections = static_cast<int>(world->activeIntersections.size());
 
-            actor->current_velocity = std::min(std::max(actor->current_acceleration * timeDelta + actor->current_velocity, 0.0f),
-                                               actor->max_velocity);
-            if (actor->current_velocity < 0.01f) {
-                actor->current_velocity = 0;
-            }
+    #pragma omp for schedule(dynamic, INTERSECTION_CHUNK)
+    for (int x = 0; x < intersections; x++) {
+        updateSingleIntersection(world, world->activeIntersections[x], timeDelta, stupidIntersections, current_time);
+    }
 
-            // Only update the speed with formula if the vehicle is not at the end of the street (div by zero error)
-            // and if the distance to intersection was not updated beforehand to 0.
-            if (actor->distanceToIntersection > 0.0f && maxDrivableDistance > 0.0f) {
-
-                // Simplifying assumption. An Actor can at maximum only "see" up to the next intersection. This is
-                // advantageous both for MPI (If it was to be added) and it doesn't require the addition of a datastructure.
-                actor->current_acceleration = (frontVehicle == nullptr) ?
-                                              actor->acceleration *
-                                              (1
-                                               - std::pow(actor->current_velocity / actor->target_velocity,
-                                                       actor->acceleration_exp)
-                                               - std::pow(dynamicBrakingDistance(actor, -1 * actor->current_velocity,
-                                                       false) /
-                                                       maxDrivableDistance, 2.0f))
-                                              : // Case when the actor is in the front of the queue.
-                                              actor->acceleration *
-                                              (1
-                                               - std::pow(actor->current_velocity / actor->target_velocity,
-                                                       actor->acceleration_exp)
-                                               - std::pow(dynamicBrakingDistance(actor, actor->current_velocity - frontVehicle->current_velocity, true) /
-                                                       maxDrivableDistance,
-                                                       2.0f));       // Case when the actor is in the back of the queue.
-            }
-            else {
-                actor->current_acceleration = 0.0f;
-                actor->current_velocity = 0.0f;
-            }
-            // Will make sure traffic is still sorted
-            std::sort(street->traffic.begin(), street->traffic.end(), [](const Actor* a, const Actor* b) {
-                // Lexicographical order, starting with distanceToIntersection and then distanceToRight
-                if (a->distanceToIntersection == b->distanceToIntersection) {
-                    // this if statement make sure that no vehicles have the same ordering
-                    if (a->distanceToRight == b->distanceToRight) {
-                        return a < b;
-                    }
-                    return a->distanceToRight < b->distanceToRight;
-                }
-                return a->distanceToIntersection < b->distanceToIntersection;
-            });
-
-            assert(std::is_sorted(street->traffic.begin(), street->traffic.end(), [](const Actor* a, const Actor* b) {
-                // Lexicographical order, starting with distanceToIntersection and then distanceToRight
-                if (a->distanceToIntersection == b->distanceToIntersection) {
-                    // this if statement make sure that no vehicles have the same ordering
-                    if (a->distanceToRight == b->distanceToRight) {
-                        return a < b;
-                    }
-                    return a->distanceToRight < b->distanceToRight;
-                }
-                return a->distanceToIntersection < b->distanceToIntersection;
-            }) && "Street is sorted");
+    // See updateData
+    #pragma omp for schedule(dynamic, INTERSECTION_CHUNK)
+    for (int x = 0; x < intersections; x++) {
+        commitSingleIntersection(world->activeIntersections[x]);
+    }
 
-            actor->distanceToFront = maxDrivableDistance;
-        }
-        street->density_accumulate_bike += static_cast<float>(bikes) / street->length;
-        street->flow_accumulate_bike += static_cast<float>(bikes) / timeDelta;
-        street->density_accumulate_car += static_cast<float>(cars) / street->length;
-        street->flow_accumulate_car += static_cast<float>(cars) / timeDelta;
+    // From here on an intersection only reads and appends to its own outbound streets, so it can take in the actors it
+    // handed over, insert the next waiting actor and commit it without waiting for the other intersections.
+    #pragma omp for schedule(dynamic, INTERSECTION_CHUNK)
+    for (int x = 0; x < intersections; x++) {
+        Intersection* intersection = world->activeIntersections[x];
+        drainIncoming(intersection);
+        insertSingleIntersection(world, intersection, current_time);
+        commitSingleInsert(intersection);
     }
 
-    return actorMoved;
+    #pragma omp single
+    refreshActiveSets(world, current_time);
 }
 
 bool updateStreets(world_t* world, const float timeDelta)
 {
-    bool actorMoved = false;
+    std::vector<WorkChunk> chunks;
+    int actorMoved = 0;
+
+    #pragma omp parallel default(none) shared(world, timeDelta, chunks, actorMoved)
+    streetPhase(world, timeDelta, chunks, actorMoved);
 
-    #pragma omp parallel for reduction(||:actorMoved)  default(none) shared(world, timeDelta)
-    for (int32_t i = 0; i < 128; i++) {
-        actorMoved = singleStreetStrideUpdate(world, timeDelta, 128, i) || actorMoved;
-    }
     bool return_val = actorMoved || emptynessOfStreets(world);
     //std::cout << "Actor Moved " <<  actorMoved << " Empty " << (return_val && !actorMoved) << std::endl;
     return return_val;
@@ -613,19 +985,32 @@ bool updateStreets(world_t* world, const float timeDelta)
 
 void updateIntersections(world_t* world, const float timeDelta, bool stupidIntersections, const float current_time)
 {
-    #pragma omp parallel for  default(none) shared(world, timeDelta, stupidIntersections, current_time)
-    for (int32_t i = 0; i < 128; i++) {
-        singleIntersectionStrideUpdate(world, timeDelta, stupidIntersections, current_time, 128, i);
+    #pragma omp parallel default(none) shared(world, timeDelta, stupidIntersections, current_time)
+    intersectionPhase(world, timeDelta, stupidIntersections, current_time);
+}
+
+bool updateStep(world_t* world, const float timeDelta, bool stupidIntersections, const float current_time)
+{
+    std::vector<WorkChunk> chunks;
+    int actorMoved = 0;
+
+    // One team for the whole step, the phases are separated by the barriers of their worksharing loops.
+    #pragma omp parallel default(none) shared(world, timeDelta, stupidIntersections, current_time, chunks, actorMoved)
+    {
+        intersectionPhase(world, timeDelta, stupidIntersections, current_time);
+        streetPhase(world, timeDelta, chunks, actorMoved);
     }
 
-    updateData(world);
+    return actorMoved || emptynessOfStreets(world);
+}
 
-    #pragma omp parallel for  default(none) shared(world, timeDelta, stupidIntersections, current_time)
-    for (int32_t i = 0; i < 128; i++) {
-        singleIntersectionStrideUpdateInsert(world, current_time, 128, i);
-    }
+void updateStepInTeam(world_t* world, const float timeDelta, bool stupidIntersections, const float current_time, std::vector<WorkChunk>& chunks, int& actorMoved)
+{
+    intersectionPhase(world, timeDelta, stupidIntersections, current_time);
+    streetPhase(world, timeDelta, chunks, actorMoved);
 
-    updatetInsertData(world);
+    // The street phase ends without a barrier, the step is only done once every thread finished its chunks.
+    #pragma omp barrier
 }
 
 float dynamicBrakingDistance(const Actor* actor, const float &delta_velocity, const bool vehicleInFront)
@@ -642,16 +1027,21 @@ float dynamicBrakingDistance(const Actor* actor, const float &delta_velocity, co
 
 void resolveDeadLocks(world_t* world, const float current_time)
 {
+    if (!world->activeSetsValid) {
+        buildActiveSets(world);
+    }
+
+    // Intersections which are not active have no traffic on their inbound streets.
     int removed = 0;
-    for (auto& intersection : world->intersections) {
-        for (auto& iter : intersection.inbound) {
+    for (Intersection* intersection : world->activeIntersections) {
+        for (auto& iter : intersection->inbound) {
             if (iter->traffic.empty()) {
                 continue;
             }
 
             Actor* actor = iter->traffic.front();
             if (actor->current_velocity < 0.01f && actor->distanceToIntersection < DISTANCE_TO_CROSSING_FOR_TELEPORT) {
-                intersection.waitingToBeInserted.insert(intersection.waitingToBeInserted.begin(), actor);
+                intersection->waitingToBeInserted.push_front(actor);
                 actor->insertAfter = current_time + 5.0f;
                 iter->traffic.erase(iter->traffic.begin());
                 removed++;
@@ -659,15 +1049,24 @@ void resolveDeadLocks(world_t* world, const float current_time)
 
         }
     }
+    world->drivingActors -= removed;
+    world->waitingActors += removed;
+    refreshActiveSets(world, current_time);
     std::cout << "Removed " << removed << " vehicles" << std::endl;
 }
 
+bool drained(world_t* world)
+{
+    if (!world->activeSetsValid) {
+        buildActiveSets(world);
+    }
+    return world->waitingActors == 0 && world->drivingActors == 0;
+}
+
 bool emptynessOfStreets(world_t* world)
 {
-    bool empty = true;
-    #pragma omp parallel for reduction(&&:empty) default(none) shared(world)
-    for (int32_t i = 0; i < world->streets.size(); i++) {
-        empty = world->streets.at(i).traffic.empty() && empty;
+    if (!world->activeSetsValid) {
+        buildActiveSets(world);
     }
-    return empty;
+    return world->activeStreets.empty();
 }
\ No newline at end of file
@@ -33,7 +33,7 @@ void choseRandomPath(const world_t* world, spt_t* spt, int& start, int& end)
     start = randint(0, static_cast<int>(world->intersections.size()) - 1);
     end = start;
     int antiInfinitLoop = 0;
-    while (antiInfinitLoop < 1000 && (start == end || spt->array[start * spt->size + end] == -1)) {
+    while (antiInfinitLoop < 1000 && (start == end || nextHop(spt, start, end) == -1)) {
         start = randint(0, static_cast<int>(world->intersections.size()) - 1);
         end = randint(0, static_cast<int>(world->intersections.size()) - 1);
         ++antiInfinitLoop;
@@ -43,12 +43,33 @@ void choseRandomPath(const world_t* world, spt_t* spt, int& start, int& end)
     }
 }
 
+void allocateActors(world_t* world, const std::size_t count)
+{
+    assert(world->actorArena.empty() && "Actors are already allocated");
+    world->actorArena = std::vector<Actor>(count);
+    world->actors = std::vector<Actor*>(count);
+}
+
+int addAgentId(world_t* world, const std::string& id)
+{
+    StringTable& table = world->agentIds;
+    table.chars.append(id);
+    table.offsets.push_back(table.chars.size());
+    return static_cast<int>(table.offsets.size()) - 2;
+}
+
+std::string agentId(const world_t* world, const Actor* actor)
+{
+    const StringTable& table = world->agentIds;
+    return table.chars.substr(table.offsets.at(actor->id), table.offsets.at(actor->id + 1) - table.offsets.at(actor->id));
+}
+
 void createRandomActors(world_t* world, spt_t* spt, const ActorTypes& type, const int& minSpeed, const int& maxSpeed,
                         const int& start, const int& numberOfActors, const float& length, const int& max_start_time)
 {
 // #pragma omp parallel for default(none) shared(world, spt, type, minSpeed, maxSpeed, start, numberOfActors, length, max_start_time)
     for (int i = start;  i < start + numberOfActors; ++i) {
-        Actor* actor = new Actor();
+        Actor* actor = &world->actorArena.at(i);
         actor->type = type;
         actor->distanceToIntersection = 0.0f;
         actor->distanceToRight = 0;
@@ -56,14 +77,14 @@ void createRandomActors(world_t* world, spt_t* spt, const ActorTypes& type, cons
         actor->max_velocity = static_cast<float>(randint(minSpeed, maxSpeed)) * 0.277778f; // 30km/h to 80km/h
 //        actor->width = 1.5f;
         actor->insertAfter = static_cast<float>(randint(0, max_start_time));
-        actor->id = std::to_string(std::rand());
+        actor->id = addAgentId(world, std::to_string(std::rand()));
 
         // Filling start and end id via choose Random Path
         choseRandomPath(world, spt, actor->start_id, actor->end_id);
         assert(actor->start_id != actor->end_id && "start_id and end_id are the same");
 
-        actor->path = retrievePath(spt, actor->start_id, actor->end_id);
-        if (actor->path.empty()) {
+        setTreePath(&actor->path, spt, actor->start_id, actor->end_id);
+        if (pathEmpty(&actor->path)) {
             std::cerr << "Path is empty" << (actor->type == ActorTypes::Bike) << std::endl;
             continue;
         }